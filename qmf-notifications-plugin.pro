@@ -1,6 +1,6 @@
 TEMPLATE = subdirs
 
-SUBDIRS = src
+SUBDIRS = src tests
 
 OTHER_FILES += \
     rpm/qmf-notifications-plugin.spec
@@ -6,6 +6,9 @@ License:    BSD
 URL:        https://github.com/sailfishos/qmf-notifications-plugin
 Source0:    %{name}-%{version}.tar.bz2
 BuildRequires:  pkgconfig(Qt5Core)
+BuildRequires:  pkgconfig(Qt5DBus)
+BuildRequires:  pkgconfig(Qt5Sql)
+BuildRequires:  pkgconfig(Qt5Test)
 BuildRequires:  pkgconfig(QmfClient)
 BuildRequires:  pkgconfig(QmfMessageServer)
 BuildRequires:  pkgconfig(nemotransferengine-qt5)
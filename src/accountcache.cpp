@@ -0,0 +1,177 @@
+/*
+ * Copyright (c) 2026 Jolla Ltd.
+ *
+ * This file is part of qmf-notifications-plugin
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+#include "accountcache.h"
+#include "diagnostics.h"
+
+AccountCache::AccountCache(QObject *parent)
+    : QObject(parent)
+    , _enabledAccountsValid(false)
+{
+    QMailStore *storage = QMailStore::instance();
+
+    connect(storage, &QMailStore::accountsAdded,
+            this, &AccountCache::accountsAdded);
+    connect(storage, &QMailStore::accountsUpdated,
+            this, &AccountCache::accountsChanged);
+    connect(storage, &QMailStore::accountsRemoved,
+            this, &AccountCache::accountsChanged);
+    connect(storage, &QMailStore::foldersAdded,
+            this, &AccountCache::foldersChanged);
+    connect(storage, &QMailStore::foldersUpdated,
+            this, &AccountCache::foldersChanged);
+    connect(storage, &QMailStore::foldersRemoved,
+            this, &AccountCache::foldersRemoved);
+}
+
+QString AccountCache::name(const QMailAccountId &accountId)
+{
+    return account(accountId).name;
+}
+
+QString AccountCache::iconPath(const QMailAccountId &accountId)
+{
+    return account(accountId).iconPath;
+}
+
+QList<QMailFolderId> AccountCache::foldersToSync(const QMailAccountId &accountId)
+{
+    AccountInfo &info(account(accountId));
+    if (!info.foldersToSyncValid) {
+        loadFolders(QMailAccount(accountId), &info);
+        Diagnostics::instance()->increment(Diagnostics::StoreQueries);
+    }
+    return info.foldersToSync;
+}
+
+QMailAccountIdList AccountCache::enabledAccounts()
+{
+    if (!_enabledAccountsValid) {
+        _enabledAccounts = QMailStore::instance()->queryAccounts(QMailAccountKey::messageType(QMailMessage::Email)
+                                                                 & QMailAccountKey::status(QMailAccount::Enabled));
+        _enabledAccountsValid = true;
+        Diagnostics::instance()->increment(Diagnostics::StoreQueries);
+    }
+    return _enabledAccounts;
+}
+
+bool AccountCache::isSynchronized(const QMailAccountId &accountId)
+{
+    return account(accountId).synchronized;
+}
+
+AccountCache::AccountInfo &AccountCache::account(const QMailAccountId &accountId)
+{
+    QHash<QMailAccountId, AccountInfo>::iterator it = _accounts.find(accountId);
+    if (it == _accounts.end()) {
+        // Add the properties for this account
+        const QMailAccount account(accountId);
+        AccountInfo info;
+        info.name = account.name();
+        info.iconPath = account.iconPath();
+        info.synchronized = account.lastSynchronized().isValid();
+        loadFolders(account, &info);
+        it = _accounts.insert(accountId, info);
+        Diagnostics::instance()->increment(Diagnostics::StoreQueries);
+    }
+    return *it;
+}
+
+void AccountCache::loadFolders(const QMailAccount &account, AccountInfo *info)
+{
+    info->foldersToSync = account.foldersToSync();
+    info->folders.clear();
+    for (const QMailFolderId &folderId : QMailStore::instance()->queryFolders(
+             QMailFolderKey::parentAccountId(account.id()))) {
+        info->folders.insert(folderId);
+    }
+    info->foldersToSyncValid = true;
+    Diagnostics::instance()->increment(Diagnostics::StoreQueries);
+}
+
+// ################ Slots #####################
+
+void AccountCache::accountsAdded(const QMailAccountIdList &ids)
+{
+    Q_UNUSED(ids)
+    _enabledAccountsValid = false;
+}
+
+void AccountCache::accountsChanged(const QMailAccountIdList &ids)
+{
+    for (const QMailAccountId &id : ids) {
+        _accounts.remove(id);
+    }
+    _enabledAccountsValid = false;
+}
+
+void AccountCache::foldersChanged(const QMailFolderIdList &ids)
+{
+    invalidateFolders(ids, true);
+}
+
+void AccountCache::foldersRemoved(const QMailFolderIdList &ids)
+{
+    // Folders unknown to the cache belong to accounts not cached, or were
+    // added after their account's folders were loaded and invalidated them
+    invalidateFolders(ids, false);
+}
+
+// Invalidates the folder lists of the accounts the folders belong to, without
+// querying the store. Folders unknown to the cache are new ones, with
+// invalidateUnknown they invalidate the folder lists of all accounts.
+// Folders of accounts already invalidated are still known, so a sync only
+// reloads the folder lists of its own account.
+void AccountCache::invalidateFolders(const QMailFolderIdList &ids, bool invalidateUnknown)
+{
+    QSet<QMailAccountId> accountIds;
+    bool unknown = false;
+    for (const QMailFolderId &id : ids) {
+        bool known = false;
+        for (QHash<QMailAccountId, AccountInfo>::const_iterator it = _accounts.constBegin();
+             it != _accounts.constEnd(); ++it) {
+            if (it->folders.contains(id)) {
+                accountIds.insert(it.key());
+                known = true;
+                break;
+            }
+        }
+        unknown = unknown || !known;
+    }
+
+    for (QHash<QMailAccountId, AccountInfo>::iterator it = _accounts.begin(); it != _accounts.end(); ++it) {
+        if ((unknown && invalidateUnknown) || accountIds.contains(it.key())) {
+            it->foldersToSyncValid = false;
+        }
+    }
+}
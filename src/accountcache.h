@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2026 Jolla Ltd.
+ *
+ * This file is part of qmf-notifications-plugin
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+#ifndef ACCOUNTCACHE_H
+#define ACCOUNTCACHE_H
+
+// QMF
+#include <qmailstore.h>
+
+// Qt
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QString>
+
+// Account properties used by the plugin, kept for the lifetime of the
+// process and invalidated when the mail store reports account or folder changes.
+class AccountCache : public QObject
+{
+    Q_OBJECT
+public:
+    explicit AccountCache(QObject *parent = 0);
+
+    QString name(const QMailAccountId &accountId);
+    QString iconPath(const QMailAccountId &accountId);
+    QList<QMailFolderId> foldersToSync(const QMailAccountId &accountId);
+    QMailAccountIdList enabledAccounts();
+    bool isSynchronized(const QMailAccountId &accountId);
+
+private slots:
+    void accountsAdded(const QMailAccountIdList &ids);
+    void accountsChanged(const QMailAccountIdList &ids);
+    void foldersChanged(const QMailFolderIdList &ids);
+    void foldersRemoved(const QMailFolderIdList &ids);
+
+private:
+    struct AccountInfo
+    {
+        QString name;
+        QString iconPath;
+        QList<QMailFolderId> foldersToSync;
+        // All folders of the account, changes to other folders don't affect it
+        QSet<QMailFolderId> folders;
+        bool foldersToSyncValid;
+        // Synchronized at least once, updating the account refreshes it
+        bool synchronized;
+    };
+
+    AccountInfo &account(const QMailAccountId &accountId);
+    void loadFolders(const QMailAccount &account, AccountInfo *info);
+    void invalidateFolders(const QMailFolderIdList &ids, bool invalidateUnknown);
+
+    QHash<QMailAccountId, AccountInfo> _accounts;
+    QMailAccountIdList _enabledAccounts;
+    bool _enabledAccountsValid;
+};
+
+#endif // ACCOUNTCACHE_H
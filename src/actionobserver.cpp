@@ -33,23 +33,37 @@
  */
 
 #include "actionobserver.h"
+#include "diagnostics.h"
+#include "syncevents.h"
 
 // QMF
 #include <qmailmessage.h>
-#include <qmailaccount.h>
 
 // Qt
 #include <QtGlobal>
 #include <QTimer>
 #include <QDebug>
 
-RunningAction::RunningAction(QSharedPointer<QMailActionInfo> action, QObject *parent)
+namespace {
+
+// Time to wait after the last action has completed before reporting it,
+// in case of multiple accounts sync, new actions will start only after
+// first ones are done. The delay follows the gaps observed between an
+// action completing and the next one starting, within these bounds.
+const int MinActionQueueDelay = 200;
+const int MaxActionQueueDelay = 1000;
+const int ActionGapMargin = 50;
+const int RecentActionGaps = 16;
+// Completed action ids remembered to filter out late actionsChanged updates,
+// actions are reported by the server shortly after they complete.
+const int MaxCompletedActions = 256;
+
+}
+
+RunningAction::RunningAction(QSharedPointer<QMailActionInfo> action, SyncEvents *syncEvents, QObject *parent)
     : QObject(parent)
-    , _progress(0.0)
-    , _transferId(0)
-    , _runningInTransferEngine(false)
     , _action(action)
-    , _transferClient(new TransferEngineClient(this))
+    , _syncEvents(syncEvents)
 {
     connect(_action.data(), &QMailActionInfo::activityChanged,
             this, &RunningAction::activityChanged);
@@ -71,13 +85,7 @@ void RunningAction::activityChanged(QMailServiceAction::Activity activity)
                 qWarning() << Q_FUNC_INFO <<  "Invalid account id, will not emit transmitFailed";
             }
         }
-        if (_runningInTransferEngine) {
-            //: Notifies in transfer-ui that email sync failed
-            //% "Email Sync Failed"
-            QString error = qtTrId("qmf-notification_email_sync_failed");
-            _transferClient->finishTransfer(_transferId, TransferEngineClient::TransferInterrupted, error);
-            _runningInTransferEngine = false;
-        }
+        _syncEvents->actionFinished(_action->id(), false);
         emit actionComplete(_action->id());
         break;
     case QMailServiceAction::Successful:
@@ -89,10 +97,7 @@ void RunningAction::activityChanged(QMailServiceAction::Activity activity)
                 qWarning() << Q_FUNC_INFO <<  "Invalid account id, will not emit transmitCompleted";
             }
         }
-        if (_runningInTransferEngine) {
-            _transferClient->finishTransfer(_transferId, TransferEngineClient::TransferFinished);
-            _runningInTransferEngine = false;
-        }
+        _syncEvents->actionFinished(_action->id(), true);
         emit actionComplete(_action->id());
         break;
     default:
@@ -104,14 +109,7 @@ void RunningAction::activityChanged(QMailServiceAction::Activity activity)
 void RunningAction::progressChanged(uint value, uint total)
 {
     if (value < total) {
-        qreal percent = qBound<qreal>(0.0, (qreal)value / total, 1.0);
-        // Avoid spamming transfer-ui
-        if (percent > _progress + 0.05 || percent == 1) {
-            _progress = percent;
-            if (_runningInTransferEngine) {
-                _transferClient->updateTransferProgress(_transferId, _progress);
-            }
-        }
+        _syncEvents->actionProgress(_action->id(), qBound<qreal>(0.0, (qreal)value / total, 1.0));
     }
 }
 
@@ -120,27 +118,28 @@ void RunningAction::statusAccountIdChanged(const QMailAccountId &accountId)
     if (!accountId.isValid()) {
         qDebug() << Q_FUNC_INFO << "Account " << accountId.toULongLong()
                  << " was removed/disabled while action was in progress, no actions to report for invalid account.";
-    } else if (!_runningInTransferEngine) {
-        QMailAccount account(accountId);
-        _transferId = _transferClient->createSyncEvent(account.name(), QUrl(), QUrl(account.iconPath()));
-        if (_transferId) {
-            _runningInTransferEngine = true;
-            _transferClient->startTransfer(_transferId);
-        } else {
-            qWarning() << Q_FUNC_INFO << "Failed to create sync event in transfer engine!";
-        }
     } else {
-        qWarning() << Q_FUNC_INFO << "This action is already running in the transfer engine!";
+        _syncEvents->actionStarted(_action->id(), accountId);
     }
-
 }
 
-ActionObserver::ActionObserver(QObject *parent)
+ActionObserver::ActionObserver(AccountCache *accounts, QObject *parent)
     : QObject(parent)
     , _actionObserver(new QMailActionObserver(this))
+    , _syncEvents(new SyncEvents(accounts, this))
+    , _queueTimer(new QTimer(this))
+    , _queueDrained(false)
+    , _queueDrainedDeadline(0)
 {
+    _clock.start();
+
     connect(_actionObserver, &QMailActionObserver::actionsChanged,
             this, &ActionObserver::actionsChanged);
+
+    _queueTimer->setSingleShot(true);
+    connect(_queueTimer, &QTimer::timeout,
+            this, &ActionObserver::emptyActionQueue);
+    Diagnostics::instance()->setValue(QStringLiteral("actionQueueDelayMs"), queueDelay());
 }
 
 // Report only long sync type of actions.
@@ -166,11 +165,21 @@ void ActionObserver::actionsChanged(QList<QSharedPointer<QMailActionInfo> > acti
         // discard actions already in the queue and fast actions to avoid spamming transfer-ui
         if (!_runningActions.contains(action->id()) && isNotificationAction(action->requestType())
                 && !_completedActions.contains(action->id())) {
-            RunningAction* runningAction = new RunningAction(action, this);
+            recordActionGap();
+
+            RunningAction* runningAction = new RunningAction(action, _syncEvents, this);
             _runningActions.insert(action->id(), runningAction);
             connect(runningAction, &RunningAction::actionComplete,
                     this, &ActionObserver::actionCompleted);
 
+            // The account may only be known once the action has started
+            const quint64 actionId = action->id();
+            setActionAccount(actionId, action->statusAccountId());
+            connect(action.data(), &QMailActionInfo::statusAccountIdChanged,
+                    this, [this, actionId] (const QMailAccountId &accountId) {
+                        setActionAccount(actionId, accountId);
+                    });
+
             // connect notifications signals if is a transmit action
             if (action->requestType() == TransmitMessagesRequestType) {
                 connect(runningAction, &RunningAction::transmitCompleted,
@@ -183,13 +192,12 @@ void ActionObserver::actionsChanged(QList<QSharedPointer<QMailActionInfo> > acti
 
     if (actionsList.size() == 0) {
         // Sometimes actionsChanged signals comes too late still containing actions that are already completed
-         if (_completedActions.size() > 0) {
-             _completedActions.clear();
-         }
-         // No more actions running, wait before emiting the signal,
-         // in case of multiple accounts sync, new actions will start
-         // only after first ones are done.
-         QTimer::singleShot(1000, this, SLOT(emptyActionQueue()));
+         _completedActions.clear();
+         _completedOrder.clear();
+         // No more actions running, wait before emiting the signal
+         _queueDrained = true;
+         _queueDrainedDeadline = queueDeadline();
+         scheduleQueueTimer();
     }
 }
 
@@ -197,17 +205,148 @@ void ActionObserver::actionCompleted(quint64 id)
 {
     Q_ASSERT(_runningActions.contains(id));
     _runningActions.take(id)->deleteLater();
-    _completedActions.append(id);
+    if (_completedOrder.size() == MaxCompletedActions) {
+        _completedActions.remove(_completedOrder.dequeue());
+    }
+    _completedOrder.enqueue(id);
+    _completedActions.insert(id);
+
+    const QMailAccountId accountId(_actionAccounts.take(id));
+    if (accountId.isValid()) {
+        QHash<QMailAccountId, int>::iterator it = _accountActionCounts.find(accountId);
+        if (it != _accountActionCounts.end() && --(*it) == 0) {
+            // Wait before reporting, the account may start its next action
+            _accountActionCounts.erase(it);
+            _drainedAccounts.insert(accountId, queueDeadline());
+            scheduleQueueTimer();
+        }
+    }
+
+    // The queue was reported empty while this action was still running
+    if (_queueDrained && _runningActions.isEmpty()) {
+        _queueDrainedDeadline = queueDeadline();
+        scheduleQueueTimer();
+    }
 }
 
 void ActionObserver::emptyActionQueue()
 {
-    if (_runningActions.empty()) {
+    const qint64 now = _clock.elapsed();
+
+    QList<QMailAccountId> drainedAccounts;
+    QHash<QMailAccountId, qint64>::iterator it = _drainedAccounts.begin();
+    while (it != _drainedAccounts.end()) {
+        if (*it <= now) {
+            drainedAccounts.append(it.key());
+            it = _drainedAccounts.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    for (const QMailAccountId &accountId : drainedAccounts) {
+        if (!hasRunningAction(accountId)) {
+            emit accountActionsCompleted(accountId);
+        }
+    }
+
+    if (_queueDrained && _runningActions.empty() && _queueDrainedDeadline <= now) {
+        _queueDrained = false;
         emit actionsCompleted();
     }
+
+    scheduleQueueTimer();
 }
 
 bool ActionObserver::hasRunningAction() const
 {
     return !_runningActions.isEmpty();
 }
+
+bool ActionObserver::hasRunningAction(const QMailAccountId &accountId) const
+{
+    return _accountActionCounts.contains(accountId);
+}
+
+// Returns the time at which a completion happening now is reported
+qint64 ActionObserver::queueDeadline()
+{
+    _lastCompletion.start();
+    return _clock.elapsed() + queueDelay();
+}
+
+// Runs the timer until the earliest deadline, the completions of one account
+// don't delay the reporting of the others
+void ActionObserver::scheduleQueueTimer()
+{
+    bool pending = _queueDrained && _runningActions.isEmpty();
+    qint64 deadline = _queueDrainedDeadline;
+    for (qint64 accountDeadline : _drainedAccounts) {
+        if (!pending || accountDeadline < deadline) {
+            deadline = accountDeadline;
+            pending = true;
+        }
+    }
+
+    if (!pending) {
+        _queueTimer->stop();
+    } else {
+        _queueTimer->start(static_cast<int>(qMax<qint64>(0, deadline - _clock.elapsed())));
+    }
+}
+
+// Waits slightly longer than the recent back-to-back gaps between actions
+int ActionObserver::queueDelay() const
+{
+    if (_recentGaps.isEmpty()) {
+        return MaxActionQueueDelay;
+    }
+
+    qint64 maxGap = 0;
+    for (qint64 gap : _recentGaps) {
+        maxGap = qMax(maxGap, gap);
+    }
+    return static_cast<int>(qBound<qint64>(MinActionQueueDelay, maxGap + maxGap / 4 + ActionGapMargin,
+                                           MaxActionQueueDelay));
+}
+
+void ActionObserver::recordActionGap()
+{
+    if (!_lastCompletion.isValid()) {
+        return;
+    }
+
+    const qint64 gap = _lastCompletion.elapsed();
+    _lastCompletion.invalidate();
+    Diagnostics::instance()->record(Diagnostics::ActionGap, gap * 1000);
+
+    // Longer gaps separate unrelated syncs, waiting for them would only add latency
+    if (gap <= MaxActionQueueDelay) {
+        if (_recentGaps.count() == RecentActionGaps) {
+            _recentGaps.removeFirst();
+        }
+        _recentGaps.append(gap);
+        Diagnostics::instance()->setValue(QStringLiteral("actionQueueDelayMs"), queueDelay());
+    }
+}
+
+void ActionObserver::setActionAccount(quint64 id, const QMailAccountId &accountId)
+{
+    if (!accountId.isValid() || !_runningActions.contains(id)) {
+        return;
+    }
+
+    QHash<quint64, QMailAccountId>::iterator it = _actionAccounts.find(id);
+    if (it != _actionAccounts.end()) {
+        if (*it == accountId) {
+            return;
+        }
+        QHash<QMailAccountId, int>::iterator count = _accountActionCounts.find(*it);
+        if (count != _accountActionCounts.end() && --(*count) == 0) {
+            _accountActionCounts.erase(count);
+        }
+    }
+
+    _actionAccounts.insert(id, accountId);
+    ++_accountActionCounts[accountId];
+    _drainedAccounts.remove(accountId);
+}
@@ -35,21 +35,25 @@
 #ifndef ACTIONOBSERVER_H
 #define ACTIONOBSERVER_H
 
-// nemotransferengine-qt5
-#include <transferengineclient.h>
-
 // QMF
 #include <qmailserviceaction.h>
 
 // Qt
+#include <QElapsedTimer>
 #include <QObject>
+#include <QQueue>
+#include <QSet>
 #include <QSharedPointer>
 
+class AccountCache;
+class SyncEvents;
+class QTimer;
+
 class RunningAction : public QObject
 {
     Q_OBJECT
 public:
-    explicit RunningAction(QSharedPointer<QMailActionInfo> action,
+    explicit RunningAction(QSharedPointer<QMailActionInfo> action, SyncEvents *syncEvents,
                            QObject *parent = 0);
 
 private slots:
@@ -63,23 +67,22 @@ signals:
     void transmitFailed(const QMailAccountId &accountId);
 
 private:
-    qreal _progress;
-    int _transferId;
-    bool _runningInTransferEngine;
     QSharedPointer<QMailActionInfo> _action;
-    TransferEngineClient *_transferClient;
+    SyncEvents *_syncEvents;
 };
 
 class ActionObserver : public QObject
 {
     Q_OBJECT
 public:
-    explicit ActionObserver(QObject *parent = 0);
+    explicit ActionObserver(AccountCache *accounts, QObject *parent = 0);
 
     bool hasRunningAction() const;
+    bool hasRunningAction(const QMailAccountId &accountId) const;
 
 signals:
     void actionsCompleted();
+    void accountActionsCompleted(const QMailAccountId &accountId);
     void transmitCompleted(const QMailAccountId &accountId);
     void transmitFailed(const QMailAccountId &accountId);
 
@@ -90,10 +93,27 @@ private slots:
 
 private:
     bool isNotificationAction(QMailServerRequestType requestType);
+    void setActionAccount(quint64 id, const QMailAccountId &accountId);
+    qint64 queueDeadline();
+    void scheduleQueueTimer();
+    int queueDelay() const;
+    void recordActionGap();
 
     QMailActionObserver *_actionObserver;
-    QList<quint64> _completedActions;
+    SyncEvents *_syncEvents;
+    QSet<quint64> _completedActions;
+    QQueue<quint64> _completedOrder;
     QHash<quint64, RunningAction*> _runningActions;
+    QHash<quint64, QMailAccountId> _actionAccounts;
+    QHash<QMailAccountId, int> _accountActionCounts;
+    // Time at which each account without running actions is reported
+    QHash<QMailAccountId, qint64> _drainedAccounts;
+    QTimer *_queueTimer;
+    QElapsedTimer _clock;
+    bool _queueDrained;
+    qint64 _queueDrainedDeadline;
+    QElapsedTimer _lastCompletion;
+    QList<qint64> _recentGaps;
 };
 
 #endif // ACTIONOBSERVER_H
@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) 2026 Jolla Ltd.
+ *
+ * This file is part of qmf-notifications-plugin
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+#include "diagnostics.h"
+
+namespace {
+
+const int BucketCount = 26;
+
+const char *const counterNames[] = {
+    "storeQueries",
+    "notificationCalls",
+    "notificationsPublished",
+    "notificationsClosed",
+    "transferEngineCalls",
+    "duplicateMessages",
+    "promotedCopies"
+};
+
+const char *const timerNames[] = {
+    "addMessages",
+    "updateMessages",
+    "removeMessages",
+    "publishChanges",
+    "updateNotifications",
+    "transferEngine",
+    "publishLatency",
+    "reload",
+    "actionGap",
+    "messageLoad"
+};
+
+}
+
+Diagnostics::Diagnostics()
+    : QObject()
+{
+    Q_STATIC_ASSERT(sizeof(counterNames) / sizeof(counterNames[0]) == CounterCount);
+    Q_STATIC_ASSERT(sizeof(timerNames) / sizeof(timerNames[0]) == TimerCount);
+    reset();
+}
+
+Diagnostics *Diagnostics::instance()
+{
+    static Diagnostics *diagnostics = new Diagnostics;
+    return diagnostics;
+}
+
+void Diagnostics::increment(Counter counter, quint64 amount)
+{
+    _counters[counter] += amount;
+}
+
+void Diagnostics::record(Timer timer, qint64 usecs)
+{
+    Histogram &histogram(_timers[timer]);
+    ++histogram.count;
+    histogram.total += usecs;
+    histogram.max = qMax(histogram.max, usecs);
+
+    int bucket = 0;
+    while (bucket < BucketCount - 1 && usecs >= (Q_INT64_C(1) << bucket)) {
+        ++bucket;
+    }
+    ++histogram.buckets[bucket];
+}
+
+void Diagnostics::setValue(const QString &name, const QVariant &value)
+{
+    _values.insert(name, value);
+}
+
+// ################ Slots #####################
+
+QVariantMap Diagnostics::statistics() const
+{
+    QVariantMap counters;
+    for (int i = 0; i < CounterCount; ++i) {
+        counters.insert(QLatin1String(counterNames[i]), _counters[i]);
+    }
+
+    QVariantMap timers;
+    for (int i = 0; i < TimerCount; ++i) {
+        const Histogram &histogram(_timers[i]);
+        QVariantList buckets;
+        for (quint64 bucket : histogram.buckets) {
+            buckets.append(bucket);
+        }
+
+        QVariantMap timer;
+        timer.insert(QStringLiteral("count"), histogram.count);
+        timer.insert(QStringLiteral("totalUs"), histogram.total);
+        timer.insert(QStringLiteral("maxUs"), histogram.max);
+        timer.insert(QStringLiteral("histogram"), buckets);
+        timers.insert(QLatin1String(timerNames[i]), timer);
+    }
+
+    QVariantMap statistics;
+    statistics.insert(QStringLiteral("counters"), counters);
+    statistics.insert(QStringLiteral("timers"), timers);
+    statistics.insert(QStringLiteral("values"), _values);
+    return statistics;
+}
+
+void Diagnostics::reset()
+{
+    for (int i = 0; i < CounterCount; ++i) {
+        _counters[i] = 0;
+    }
+
+    for (int i = 0; i < TimerCount; ++i) {
+        Histogram &histogram(_timers[i]);
+        histogram.count = 0;
+        histogram.total = 0;
+        histogram.max = 0;
+        histogram.buckets.fill(0, BucketCount);
+    }
+}
+
+DiagnosticsTimer::DiagnosticsTimer(Diagnostics::Timer timer)
+    : _timer(timer)
+{
+    _elapsed.start();
+}
+
+DiagnosticsTimer::~DiagnosticsTimer()
+{
+    Diagnostics::instance()->record(_timer, _elapsed.nsecsElapsed() / 1000);
+}
@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2026 Jolla Ltd.
+ *
+ * This file is part of qmf-notifications-plugin
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+#ifndef DIAGNOSTICS_H
+#define DIAGNOSTICS_H
+
+// Qt
+#include <QElapsedTimer>
+#include <QObject>
+#include <QVariantMap>
+#include <QVector>
+
+// Counters and latency histograms of the plugin hot paths, readable over D-Bus
+class Diagnostics : public QObject
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "org.sailfishos.qmf.notifications.Diagnostics")
+public:
+    enum Counter {
+        StoreQueries,
+        NotificationCalls,
+        NotificationsPublished,
+        NotificationsClosed,
+        TransferEngineCalls,
+        DuplicateMessages,
+        PromotedCopies,
+        CounterCount
+    };
+
+    enum Timer {
+        AddMessagesTime,
+        UpdateMessagesTime,
+        RemoveMessagesTime,
+        PublishChangesTime,
+        UpdateNotificationsTime,
+        TransferEngineTime,
+        PublishLatency,
+        ReloadTime,
+        ActionGap,
+        MessageLoadTime,
+        TimerCount
+    };
+
+    static Diagnostics *instance();
+
+    void increment(Counter counter, quint64 amount = 1);
+    // Records a duration in microseconds
+    void record(Timer timer, qint64 usecs);
+    // Reports the current value of a tuning parameter
+    void setValue(const QString &name, const QVariant &value);
+
+public slots:
+    Q_SCRIPTABLE QVariantMap statistics() const;
+    Q_SCRIPTABLE void reset();
+
+private:
+    struct Histogram
+    {
+        quint64 count;
+        qint64 total;
+        qint64 max;
+        // Bucket n counts durations below 2^n microseconds, the last one the rest
+        QVector<quint64> buckets;
+    };
+
+    Diagnostics();
+
+    quint64 _counters[CounterCount];
+    Histogram _timers[TimerCount];
+    QVariantMap _values;
+};
+
+// Records the lifetime of the object into the given timer
+class DiagnosticsTimer
+{
+public:
+    explicit DiagnosticsTimer(Diagnostics::Timer timer);
+    ~DiagnosticsTimer();
+
+private:
+    Diagnostics::Timer _timer;
+    QElapsedTimer _elapsed;
+};
+
+#endif // DIAGNOSTICS_H
@@ -33,13 +33,18 @@
  */
 
 #include "mailstoreobserver.h"
+#include "diagnostics.h"
+#include "publishedsnapshot.h"
 
 // nemoemail-qt5
 #include <emailagent.h>
 
 // Qt
+#include <QCryptographicHash>
 #include <QDBusConnection>
+#include <QDBusServiceWatcher>
 #include <QDebug>
+#include <QTimer>
 
 namespace {
 
@@ -47,41 +52,58 @@ const auto dbusService = QStringLiteral("com.jolla.email.ui");
 const auto dbusPath = QStringLiteral("/com/jolla/email/ui");
 const auto dbusInterface = QStringLiteral("com.jolla.email.ui");
 
+const auto notificationsService = QStringLiteral("org.freedesktop.Notifications");
+
 const auto publishedMessageId = QStringLiteral("x-nemo.email.published-message-id");
+const auto sendFailedAccountId = QStringLiteral("x-nemo.email.sendFailed-accountId");
+const auto firstSyncAccountId = QStringLiteral("x-nemo.email.firstSync-accountId");
+
+// Set to "conversation" to publish one notification per conversation, or per
+// sender for messages outside of conversations
+const char *const groupingVariable = "QMF_NOTIFICATIONS_GROUPING";
+
 const auto markAsReadAction = QStringLiteral("markAsRead");
 
+// Hints set with Notification::setHintValue(), sent along with the notification properties
+const QStringList notificationHints {
+    QStringLiteral("x-nemo-display-on"),
+    QStringLiteral("x-nemo-priority"),
+    QStringLiteral("x-nemo-feedback"),
+    publishedMessageId,
+    sendFailedAccountId,
+    firstSyncAccountId
+};
+
 const int MaxNotificationsPerAccount = 100;
 
-QVariant remoteAction(const QString &name, const QString &displayName, const QString &method,
-                      const QVariantList &arguments = QVariantList())
-{
-    return Notification::remoteAction(name, displayName, dbusService, dbusPath, dbusInterface, method, arguments);
-}
+// Store changes arriving within this many milliseconds of each other are published together,
+// but never later than MaxChangesLatency milliseconds after the first one
+const int ChangesCoalesceDelay = 100;
+const int MaxChangesLatency = 500;
 
-QVariantList singleMessageRemoteActionList(Notification *notification, const MessageInfo &messageInfo)
-{
-    const int messageId = static_cast<int>(messageInfo.id.toULongLong());
-    QVariantList messageArg(QVariantList () << messageId);
+// Number of reloaded notifications matched against the store at a time
+const int ReloadChunkSize = 500;
 
-    QVariantList actions;
-    actions << ::remoteAction("default", QString(), "openMessage", messageArg);
+// Messages marked as read within this many milliseconds are updated together
+const int MarkAsReadDelay = 300;
 
-    if (messageInfo.hasMultipleRecipients) {
-        //: Reply to all recipients of this email
-        //% "Reply all"
-        actions << ::remoteAction(QString(), qtTrId("qmf-notification_reply_all"), "replyAllToMessage", messageArg);
-    } else {
-        //: Reply to this email
-        //% "Reply"
-        actions << ::remoteAction(QString(), qtTrId("qmf-notification_reply_one"), "replyToMessage", messageArg);
-    }
+// Time to wait after publishing before saving the published messages,
+// the notifications have their ids by then
+const int SnapshotDelay = 5000;
 
-    //: Mark an email as "read"
-    //% "Mark as read"
-    actions << Notification::remoteAction(markAsReadAction, qtTrId("qmf-notification_mark_as_read"));
-    notification->setProperty("messageId", messageId);
+const auto actionArguments = QStringLiteral("arguments");
+
+QVariantMap remoteAction(const QString &name, const QString &displayName, const QString &method)
+{
+    return Notification::remoteAction(name, displayName, dbusService, dbusPath, dbusInterface, method).toMap();
+}
 
-    return actions;
+// Returns the action template with its single argument filled in
+QVariant remoteAction(const QVariantMap &action, const QVariant &argument)
+{
+    QVariantMap filled(action);
+    filled.insert(actionArguments, QVariantList() << argument);
+    return filled;
 }
 
 void initNotification(Notification *notification)
@@ -97,46 +119,76 @@ void initNotification(Notification *notification)
     notification->setHintValue("x-nemo-priority", 100);
 }
 
-QPair<QString, QString> accountProperties(const QMailAccountId &accountId)
+// Copies of a message share its Message-ID header, or when it is missing
+// the sender, subject and date
+QByteArray duplicateKey(const MessageInfo &message)
 {
-    static QHash<QMailAccountId, QPair<QString, QString> > properties;
-
-    QHash<QMailAccountId, QPair<QString, QString> >::iterator it = properties.find(accountId);
-    if (it == properties.end()) {
-        // Add the properties for this account
-        QMailAccount account(accountId);
-        it = properties.insert(accountId, qMakePair(account.name(), account.iconPath()));
-    }
-    return *it;
+    const QString key(message.rfcId.isEmpty()
+                      ? QStringLiteral("%1\n%2\n%3").arg(message.origin, message.subject,
+                                                         QString::number(message.timeStamp.toMSecsSinceEpoch()))
+                      : message.rfcId);
+    return QCryptographicHash::hash(key.toUtf8(), QCryptographicHash::Md5);
 }
 
-struct MessageEarlierComparator {
-    bool operator()(const MessageInfo *lhs, const MessageInfo *rhs)
-    {
-        return lhs->timeStamp < rhs->timeStamp;
-    }
-};
-
 }
 
-MailStoreObserver::MailStoreObserver(QObject *parent)
+MailStoreObserver::MailStoreObserver(AccountCache *accounts, QObject *parent)
     : QObject(parent)
     , _publicationChanges(false)
     , _appOnScreen(false)
     , _storage(0)
+    , _accounts(accounts)
+    , _changesTimer(new QTimer(this))
+    , _snapshotTimer(new QTimer(this))
+    , _markAsReadTimer(new QTimer(this))
+    , _queue(new NotificationQueue(notificationHints, this))
+    , _loader(new MessageLoader(this))
+    , _reloading(true)
+    , _pendingReloads(0)
+    , _grouping(qgetenv(groupingVariable) == "conversation")
 {
     _storage = QMailStore::instance();
 
+    _changesTimer->setSingleShot(true);
+    connect(_changesTimer, &QTimer::timeout,
+            this, &MailStoreObserver::mailStoreChanges);
+
+    _snapshotTimer->setSingleShot(true);
+    _snapshotTimer->setInterval(SnapshotDelay);
+    connect(_snapshotTimer, &QTimer::timeout,
+            this, &MailStoreObserver::saveSnapshot);
+
+    _markAsReadTimer->setSingleShot(true);
+    _markAsReadTimer->setInterval(MarkAsReadDelay);
+    connect(_markAsReadTimer, &QTimer::timeout,
+            this, &MailStoreObserver::markPendingAsRead);
+
+    connect(_loader, &MessageLoader::loaded,
+            this, &MailStoreObserver::messagesLoaded);
+
     connect(_storage, &QMailStore::messagesAdded,
             this, &MailStoreObserver::addMessages);
     connect(_storage, &QMailStore::messagesUpdated,
             this, &MailStoreObserver::updateMessages);
     connect(_storage, &QMailStore::messagesRemoved,
             this, &MailStoreObserver::removeMessages);
+    connect(_storage, &QMailStore::accountsAdded,
+            this, &MailStoreObserver::accountsAdded);
+    connect(_storage, &QMailStore::accountsRemoved,
+            this, &MailStoreObserver::accountsRemoved);
 
-    reloadNotifications();
+    // Reload once the event loop is running to not delay the message server startup
+    QTimer::singleShot(0, this, &MailStoreObserver::reloadNotifications);
 
     QDBusConnection dbusSession(QDBusConnection::sessionBus());
+
+    // Notifications are only queried again from the daemon if it gets restarted
+    QDBusServiceWatcher *notificationsWatcher = new QDBusServiceWatcher(notificationsService, dbusSession,
+                                                                        QDBusServiceWatcher::WatchForRegistration,
+                                                                        this);
+    connect(notificationsWatcher, &QDBusServiceWatcher::serviceRegistered,
+            this, &MailStoreObserver::resyncNotifications);
+
     dbusSession.connect(QString(), dbusPath, dbusInterface, "displayEntered",
                         this, SLOT(setNotifyOff()));
     dbusSession.connect(QString(), dbusPath, dbusInterface, "displayExit",
@@ -147,252 +199,520 @@ MailStoreObserver::MailStoreObserver(QObject *parent)
                         this, SLOT(accountInboxDisplayed(int)));
 }
 
+MailStoreObserver::~MailStoreObserver()
+{
+    markPendingAsRead();
+
+    // A snapshot missing pending changes must not be trusted on the next start
+    if (!writeSnapshot()) {
+        PublishedSnapshot::remove();
+    }
+}
+
+// Reloads the notifications published before the message server was started.
+// Their messages are loaded in chunks like other store changes, the messages
+// found in the snapshot and the other members of their groups are checked
+// together. Changes arriving meanwhile are handled as usual and only
+// published once the reload is done.
 void MailStoreObserver::reloadNotifications()
 {
-    const QMailAccountIdList enabledAccounts(
-                QMailStore::instance()->queryAccounts(QMailAccountKey::messageType(QMailMessage::Email)
-                                                      & QMailAccountKey::status(QMailAccount::Enabled)));
+    _reloadTimer.start();
+
+    PublishedSnapshot snapshot;
+    const bool snapshotOpen = snapshot.open();
 
-    clearFoldersToSync();
     // Find the set of messages we've previously published notifications for
+    Diagnostics::instance()->increment(Diagnostics::NotificationCalls);
+    QMailMessageIdList ids;
+    QMailMessageIdList snapshotIds;
     QList<QObject *> existingNotifications(Notification::notifications());
     for (QObject *obj : existingNotifications) {
-        if (Notification *notification = qobject_cast<Notification *>(obj)) {
+        Notification *notification = qobject_cast<Notification *>(obj);
+        if (notification) {
             const QString publishedId(notification->hintValue(publishedMessageId).toString());
             const QMailMessageId messageId(QMailMessageId(publishedId.toULongLong()));
-
-            bool published = false;
-            if (messageId.isValid()) {
-                const QMailMessageMetaData message(messageId);
-
-                // Checks if parent account is still valid
-                // accounts can be removed when messageServer is not running.
-                if (enabledAccounts.contains(message.parentAccountId())) {
-                    if (shouldNotify(message)) {
-                        _publishedMessages.insert(messageId, constructMessageInfo(message));
-                        published = true;
+            if (messageId.isValid() && !_reloadedNotifications.contains(messageId)) {
+                PublishedSnapshot::Record record;
+                if (snapshotOpen && snapshot.find(messageId, &record)
+                        && record.notificationId == notification->replacesId()) {
+                    snapshotIds.append(messageId);
+                    if (_grouping) {
+                        // The hint names one message, the other members of its group share the notification id
+                        for (const PublishedSnapshot::Record &member : snapshot.notificationRecords(record.notificationId)) {
+                            if (member.message.id != messageId && !_reloadedMembers.contains(member.message.id)) {
+                                _reloadedMembers.insert(member.message.id, messageId);
+                                snapshotIds.append(member.message.id);
+                            }
+                        }
                     }
+                } else {
+                    ids.append(messageId);
                 }
+                notification->setParent(this);
+                _reloadedNotifications.insert(messageId, notification);
+                continue;
             }
-
-            if (!published) {
-                notification->close();
-            }
+            _queue->close(notification);
         }
+        delete obj;
+    }
+
+    // The snapshot can be stale, its messages are checked with a single load
+    if (!snapshotIds.isEmpty()) {
+        ++_pendingReloads;
+        enqueueOperation(StoreOperation::ReloadMessages, snapshotIds, true);
+    }
+    for (int i = 0; i < ids.count(); i += ReloadChunkSize) {
+        ++_pendingReloads;
+        enqueueOperation(StoreOperation::ReloadMessages, ids.mid(i, ReloadChunkSize), true);
+    }
+    if (!_pendingReloads) {
+        finishReload();
     }
-    qDeleteAll(existingNotifications);
 }
 
-// Close existing notifications
-void MailStoreObserver::closeNotifications()
+void MailStoreObserver::finishReload()
 {
-    QList<QObject *> existingNotifications(Notification::notifications());
-    for (QObject *obj : existingNotifications) {
-        if (Notification *notification = qobject_cast<Notification *>(obj)) {
-            notification->close();
-        }
+    _reloading = false;
+    Diagnostics::instance()->record(Diagnostics::ReloadTime, _reloadTimer.nsecsElapsed() / 1000);
+    qDebug() << "Reloaded" << _publishedMessages.count() << "published messages in"
+             << _reloadTimer.elapsed() << "ms";
+    // Publish the changes which arrived during the reload
+    scheduleChanges();
+}
+
+// Saves the published messages, unless changes are still being applied
+bool MailStoreObserver::writeSnapshot()
+{
+    if (_reloading || !_operations.isEmpty() || !_removedMessages.isEmpty()) {
+        return false;
     }
-    qDeleteAll(existingNotifications);
 
-    _publishedMessages.clear();
-    _newMessages.clear();
+    QVector<PublishedSnapshot::Record> records;
+    for (const MessageInfo &message : _publishedMessages.messages()) {
+        Notification *notification = messageNotification(message.id);
+        if (notification && notification->replacesId()) {
+            PublishedSnapshot::Record record;
+            record.message = message;
+            record.notificationId = notification->replacesId();
+            records.append(record);
+        }
+    }
+    return PublishedSnapshot::write(records);
 }
 
-void MailStoreObserver::closeAccountNotifications(const QMailAccountId &accountId)
+// Rebuilds the notification registry after the notification daemon has been restarted
+void MailStoreObserver::resyncNotifications()
 {
+    if (_reloading) {
+        return;
+    }
+
+    for (Notification *notification : _notifications.notifications()) {
+        notification->deleteLater();
+    }
+    _notifications.clear();
+
+    Diagnostics::instance()->increment(Diagnostics::NotificationCalls);
     QList<QObject *> existingNotifications(Notification::notifications());
     for (QObject *obj : existingNotifications) {
-        if (Notification *notification = qobject_cast<Notification *>(obj)) {
+        Notification *notification = qobject_cast<Notification *>(obj);
+        if (notification) {
             const QString publishedId(notification->hintValue(publishedMessageId).toString());
             const QMailMessageId messageId(QMailMessageId(publishedId.toULongLong()));
-            if (messageId.isValid()) {
-                const QMailMessageMetaData message(messageId);
-                if (message.parentAccountId() == accountId) {
-                    notification->close();
-                    removeMessage(messageId);
-                }
+            const QMailAccountId failedAccountId(notification->hintValue(sendFailedAccountId).toULongLong());
+            const QMailAccountId summaryAccountId(notification->hintValue(firstSyncAccountId).toULongLong());
+            if (_publishedMessages.contains(messageId)) {
+                adoptNotification(notification, messageId);
+                continue;
+            } else if (failedAccountId.isValid()) {
+                trackNotification(notification, NotificationRegistry::SendFailedNotification, failedAccountId);
+                continue;
+            } else if (summaryAccountId.isValid()) {
+                trackNotification(notification, NotificationRegistry::FirstSyncNotification, summaryAccountId);
+                continue;
+            } else if (messageId.isValid()) {
+                _queue->close(notification);
             }
         }
+        delete obj;
+    }
+}
+
+const MailStoreObserver::RemoteActions &MailStoreObserver::remoteActions()
+{
+    if (_remoteActions.openMessage.isEmpty()) {
+        _remoteActions.openMessage = ::remoteAction("default", QString(), "openMessage");
+        //: Reply to this email
+        //% "Reply"
+        _remoteActions.reply = ::remoteAction(QString(), qtTrId("qmf-notification_reply_one"), "replyToMessage");
+        //: Reply to all recipients of this email
+        //% "Reply all"
+        _remoteActions.replyAll = ::remoteAction(QString(), qtTrId("qmf-notification_reply_all"), "replyAllToMessage");
+        //: Mark an email as "read"
+        //% "Mark as read"
+        _remoteActions.markAsRead = Notification::remoteAction(markAsReadAction,
+                                                               qtTrId("qmf-notification_mark_as_read")).toMap();
+        _remoteActions.openInbox = ::remoteAction("default", QString(), "openInbox");
+        _remoteActions.openCombinedInbox = ::remoteAction("default", QString(), "openCombinedInbox");
+        _remoteActions.openOutbox = ::remoteAction("default", QString(), "openOutbox");
     }
-    qDeleteAll(existingNotifications);
+    return _remoteActions;
 }
 
-// Contructs messageInfo object from a email message
-QSharedPointer<MessageInfo> MailStoreObserver::constructMessageInfo(const QMailMessageMetaData &message)
+QVariantList MailStoreObserver::messageRemoteActions(Notification *notification, const MessageInfo &messageInfo)
 {
-    MessageInfo* messageInfo = new MessageInfo();
-    messageInfo->id = message.id();
+    const RemoteActions &actions(remoteActions());
+    const int messageId = static_cast<int>(messageInfo.id.toULongLong());
+    notification->setProperty("messageId", messageId);
 
-    QMailAddress mailAdress = message.from();
+    return QVariantList() << ::remoteAction(actions.openMessage, messageId)
+                          << ::remoteAction(messageInfo.hasMultipleRecipients ? actions.replyAll : actions.reply,
+                                            messageId)
+                          << actions.markAsRead;
+}
 
-    messageInfo->origin = mailAdress.address().toLower();
-    messageInfo->sender = mailAdress.name();
-    messageInfo->subject = message.subject();
-    messageInfo->timeStamp = message.date().toUTC();
-    messageInfo->accountId = message.parentAccountId();
-    messageInfo->hasMultipleRecipients = message.recipients().count() > 1;
+// Takes ownership of a published notification and records it in the registry
+void MailStoreObserver::trackNotification(Notification *notification, NotificationRegistry::Kind kind,
+                                          const QMailAccountId &accountId, const QMailMessageId &messageId,
+                                          const QString &groupKey)
+{
+    if (!_notifications.contains(notification)) {
+        notification->setParent(this);
+        connect(notification, &Notification::closed,
+                this, &MailStoreObserver::notificationClosed);
+        connect(notification, &Notification::actionInvoked,
+                this, &MailStoreObserver::notificationActionInvoked);
+    }
+    _notifications.insert(notification, kind, accountId, messageId, groupKey);
+}
 
-    return QSharedPointer<MessageInfo>(messageInfo);
+// Tracks a notification published for a message before the plugin was (re)started
+void MailStoreObserver::adoptNotification(Notification *notification, const QMailMessageId &messageId)
+{
+    notification->setProperty("messageId", static_cast<int>(messageId.toULongLong()));
+    if (_grouping) {
+        const MessageInfo message(_publishedMessages.message(messageId));
+        trackNotification(notification, NotificationRegistry::GroupNotification,
+                          message.accountId, messageId, groupKey(message));
+    } else {
+        trackNotification(notification, NotificationRegistry::MessageNotification,
+                          _publishedMessages.accountId(messageId), messageId);
+    }
 }
 
-// Check if this message should be notified, old messages are not
-// notified since QMailMessage::NoNotification is used
-bool MailStoreObserver::shouldNotify(const QMailMessageMetaData &message)
+// Returns the notification showing a published message
+Notification *MailStoreObserver::messageNotification(const QMailMessageId &messageId) const
 {
-    return message.messageType() == QMailMessage::Email
-            && !(message.status() & (QMailMessage::Read
-                                     | QMailMessage::Temporary
-                                     | QMailMessage::NoNotification
-                                     | QMailMessage::Junk
-                                     | QMailMessage::Trash))
-            && messageInFolderToSync(message);
+    if (_grouping) {
+        return _notifications.groupNotification(groupKey(_publishedMessages.message(messageId)));
+    }
+    return _notifications.messageNotification(messageId);
 }
 
-void MailStoreObserver::updateNotifications()
+QString MailStoreObserver::groupKey(const MessageInfo &message) const
 {
-    QHash<QMailMessageId, int> existingMessageNotificationIds;
+    if (message.threadId) {
+        return QStringLiteral("%1:thread:%2").arg(message.accountId.toULongLong()).arg(message.threadId);
+    }
+    return QStringLiteral("%1:sender:%2").arg(message.accountId.toULongLong()).arg(message.origin);
+}
 
-    // Limit the maximum number of notifications published for any each account
-    if (_publishedMessages.count() > MaxNotificationsPerAccount) {
-        QHash<QMailAccountId, QList<const MessageInfo *> > accountMessages;
+void MailStoreObserver::closeNotification(Notification *notification)
+{
+    _notifications.remove(notification);
+    _queue->close(notification);
+    notification->deleteLater();
+}
 
-        MessageHash::const_iterator it = _publishedMessages.constBegin(), end = _publishedMessages.constEnd();
-        for ( ; it != end; ++it) {
-            const MessageInfo *message(it.value().data());
-            accountMessages[message->accountId].append(message);
-        }
+// Makes notification replace the existing one once published
+void MailStoreObserver::replaceNotification(Notification *existing, Notification *notification)
+{
+    _notifications.remove(existing);
+    _queue->replace(existing, notification);
+    existing->deleteLater();
+}
+
+// Close existing notifications
+void MailStoreObserver::closeNotifications()
+{
+    for (Notification *notification : _reloadedNotifications) {
+        _queue->close(notification);
+        delete notification;
+    }
+    _reloadedNotifications.clear();
+    _reloadedMembers.clear();
 
-        QList<QMailMessageId> messagesToRemove;
+    for (Notification *notification : _notifications.notifications()) {
+        closeNotification(notification);
+    }
 
-        QHash<QMailAccountId, QList<const MessageInfo *> >::iterator ait = accountMessages.begin(), aend = accountMessages.end();
-        for ( ; ait != aend; ++ait) {
-            QList<const MessageInfo *> &messages(ait.value());
-            if (messages.count() > MaxNotificationsPerAccount) {
-                // Remove the notifications for the earliest messages for this account
-                std::sort(messages.begin(), messages.end(), MessageEarlierComparator());
+    _publishedMessages.clear();
+    _removedMessages.clear();
+    _groupMessages.clear();
+    _changedGroups.clear();
+    _duplicateKeys.clear();
+    _messageKeys.clear();
+    _copyOf.clear();
+    _copies.clear();
+    _promotedMessages.clear();
+}
 
-                int removeCount = messages.count() - MaxNotificationsPerAccount;
-                QList<const MessageInfo *>::const_iterator mit = messages.constBegin(), mend = mit + removeCount;
-                for ( ; mit != mend; ++mit) {
-                    messagesToRemove.append((*mit)->id);
-                }
+void MailStoreObserver::closeAccountNotifications(const QMailAccountId &accountId)
+{
+    for (Notification *notification : _notifications.accountNotifications(accountId)) {
+        const NotificationRegistry::Entry entry(_notifications.entry(notification));
+        if (entry.kind == NotificationRegistry::MessageNotification) {
+            closeNotification(notification);
+            removeMessage(entry.messageId);
+        } else if (entry.kind == NotificationRegistry::GroupNotification) {
+            closeNotification(notification);
+            for (const QMailMessageId &messageId : _groupMessages.value(entry.groupKey)) {
+                removeMessage(messageId);
             }
+        } else if (entry.kind == NotificationRegistry::FirstSyncNotification) {
+            closeNotification(notification);
         }
+    }
+}
 
-        for (const QMailMessageId &id : messagesToRemove) {
-            removeMessage(id);
+// Filter matching the messages that should be notified, old messages are not
+// notified since QMailMessage::NoNotification is used. Only messages of enabled
+// accounts are matched, accounts can be removed when messageServer is not running.
+MessageFilter MailStoreObserver::notifiableMessagesFilter()
+{
+    MessageFilter filter;
+    for (const QMailAccountId &accountId : _accounts->enabledAccounts()) {
+        for (const QMailFolderId &folderId : _accounts->foldersToSync(accountId)) {
+            filter.folderIds.append(folderId.toULongLong());
         }
     }
+    filter.excludedStatus = QMailMessage::Read
+            | QMailMessage::Temporary
+            | QMailMessage::NoNotification
+            | QMailMessage::Junk
+            | QMailMessage::Trash;
+    return filter;
+}
 
-    // Remove any existing notifications whose message should no longer be published
-    QList<QObject *> existingNotifications(Notification::notifications());
-    for (QObject *obj : existingNotifications) {
-        if (Notification *notification = qobject_cast<Notification *>(obj)) {
-            const QString publishedId(notification->hintValue(publishedMessageId).toString());
-            const QMailMessageId messageId(QMailMessageId(publishedId.toULongLong()));
-            if (!_publishedMessages.contains(messageId)) {
-                notification->close();
-            } else {
-                existingMessageNotificationIds.insert(messageId, notification->replacesId());
+// Queues a store change, its messages are loaded in the background if needed.
+// Changes are applied in the order they arrived once their messages are loaded.
+void MailStoreObserver::enqueueOperation(StoreOperation::Type type, const QMailMessageIdList &ids, bool load)
+{
+    StoreOperation operation;
+    operation.type = type;
+    operation.ids = ids;
+    if (load) {
+        MessageFilter filter(notifiableMessagesFilter());
+        if (type == StoreOperation::AddMessages) {
+            for (QHash<QMailAccountId, FirstSync>::const_iterator it = _firstSyncs.constBegin();
+                 it != _firstSyncs.constEnd(); ++it) {
+                if (!it->done) {
+                    filter.countedAccounts.append(it.key().toULongLong());
+                }
             }
         }
+        operation.serial = _loader->load(ids, filter);
+    } else {
+        operation.serial = 0;
     }
-    qDeleteAll(existingNotifications);
+    operation.loaded = !load;
+    _operations.enqueue(operation);
 
-    // Update the notification for each current message that has been modified
-    MessageHash::const_iterator it = _publishedMessages.constBegin(), end = _publishedMessages.constEnd();
-    bool feedbackSet = false;
+    processOperations();
+}
 
-    for ( ; it != end; ++it) {
-        const QMailMessageId messageId(it.key());
-        const MessageInfo *message(it.value().data());
+void MailStoreObserver::processOperations()
+{
+    while (!_operations.isEmpty() && _operations.head().loaded) {
+        const StoreOperation operation(_operations.dequeue());
+        switch (operation.type) {
+        case StoreOperation::AddMessages:
+            applyAddedMessages(operation);
+            break;
+        case StoreOperation::UpdateMessages:
+            applyUpdatedMessages(operation);
+            break;
+        case StoreOperation::RemoveMessages:
+            applyRemovedMessages(operation);
+            break;
+        case StoreOperation::ReloadMessages:
+            applyReloadedMessages(operation);
+            break;
+        }
+    }
 
-        // Only republish this message if there is something to show
-        if (!_newMessages.contains(messageId))
-            continue;
+    if (_operations.isEmpty() && !_deferredPublications.isEmpty()) {
+        const QList<QMailAccountId> deferred(_deferredPublications);
+        _deferredPublications.clear();
+        for (const QMailAccountId &accountId : deferred) {
+            publishMessages(accountId);
+        }
+    }
+}
 
-        Notification *notification = new Notification(this);
-        connect(notification, &Notification::closed,
-                this, &MailStoreObserver::notificationClosed);
-        connect(notification, &Notification::actionInvoked,
-                this, &MailStoreObserver::notificationActionInvoked);
+void MailStoreObserver::updateNotifications(const QVector<MessageInfo> &newMessages)
+{
+    DiagnosticsTimer timer(Diagnostics::UpdateNotificationsTime);
+
+    // Copies taking over from a message that went away replace its notification
+    if (!_grouping) {
+        for (QHash<QMailMessageId, QMailMessageId>::const_iterator it = _promotedMessages.constBegin();
+             it != _promotedMessages.constEnd(); ++it) {
+            Notification *existing = _notifications.messageNotification(it.value());
+            if (existing && _publishedMessages.contains(it.key())) {
+                publishMessageNotification(_publishedMessages.message(it.key()), existing, false, false);
+            }
+        }
+        _promotedMessages.clear();
+    }
 
-        // Group emails by their source account name
-        QPair<QString, QString> properties(accountProperties(message->accountId));
+    // Remove the existing notifications of messages that should no longer be published
+    for (const QMailMessageId &messageId : _removedMessages) {
+        if (Notification *notification = _notifications.messageNotification(messageId)) {
+            closeNotification(notification);
+        }
+    }
+    _removedMessages.clear();
 
-        initNotification(notification);
-        notification->setAppName(properties.first);
-        notification->setAppIcon(properties.second);
-        if (!feedbackSet) {
+    // Update the notification for each current message that has been modified
+    bool feedbackSet = false;
+
+    if (_grouping) {
+        QSet<QString> changedGroups(_changedGroups);
+        _changedGroups.clear();
+
+        QSet<QString> newGroups;
+        for (const MessageInfo &message : newMessages) {
+            newGroups.insert(groupKey(message));
+        }
+        for (const QString &key : newGroups) {
+            publishGroupNotification(key, true, !feedbackSet);
             feedbackSet = true;
-            // just set this once to ensure we don't play multiple tones etc
-            notification->setHintValue("x-nemo-feedback", "email_exists");
+            changedGroups.remove(key);
         }
-        notification->setHintValue(publishedMessageId, QString::number(messageId.toULongLong()));
-        notification->setSummary(message->sender.isEmpty() ? message->origin : message->sender);
-        notification->setBody(message->subject);
-        notification->setUrgency(Notification::Low);
-        notification->setTimestamp(message->timeStamp);
-        notification->setRemoteActions(singleMessageRemoteActionList(notification, *message));
-
-        QHash<QMailMessageId, int>::iterator existingNotif(existingMessageNotificationIds.find(messageId));
-        if (existingNotif != existingMessageNotificationIds.end()) {
-            // Replace the existing notification for this message
-            notification->setReplacesId(existingNotif.value());
+        // Groups which lost messages
+        for (const QString &key : changedGroups) {
+            publishGroupNotification(key, false, false);
         }
+        _promotedMessages.clear();
+        return;
+    }
 
-        notification->publish();
+    for (const MessageInfo &message : newMessages) {
+        // just set this once to ensure we don't play multiple tones etc
+        publishMessageNotification(message, _notifications.messageNotification(message.id), true, !feedbackSet);
+        feedbackSet = true;
     }
 }
 
+// Publishes the notification of a message in place of existing, messages
+// which are not new don't turn the display on
+void MailStoreObserver::publishMessageNotification(const MessageInfo &message, Notification *existing,
+                                                   bool isNew, bool feedback)
+{
+    Notification *notification = new Notification(this);
+
+    // Group emails by their source account name
+    initNotification(notification);
+    notification->setAppName(_accounts->name(message.accountId));
+    notification->setAppIcon(_accounts->iconPath(message.accountId));
+    if (!isNew) {
+        notification->setHintValue(QStringLiteral("x-nemo-display-on"), false);
+    }
+    if (feedback) {
+        notification->setHintValue("x-nemo-feedback", "email_exists");
+    }
+    notification->setHintValue(publishedMessageId, QString::number(message.id.toULongLong()));
+    notification->setSummary(message.sender.isEmpty() ? message.origin : message.sender);
+    notification->setBody(message.subject);
+    notification->setUrgency(Notification::Low);
+    notification->setTimestamp(message.timeStamp);
+    notification->setRemoteActions(messageRemoteActions(notification, message));
+
+    if (existing) {
+        replaceNotification(existing, notification);
+    }
+
+    _queue->publish(notification);
+    trackNotification(notification, NotificationRegistry::MessageNotification, message.accountId, message.id);
+}
+
 // ################ Slots #####################
 
 void MailStoreObserver::publishChanges()
 {
-    if (_publicationChanges) {
-        _publicationChanges = false;
+    publishMessages(QMailAccountId());
+}
 
-        updateNotifications();
+// Publishes the pending changes without waiting for the actions of other accounts,
+// new messages of other accounts stay pending
+void MailStoreObserver::publishAccountChanges(const QMailAccountId &accountId)
+{
+    publishMessages(accountId);
+}
 
-        QVector<QSharedPointer<MessageInfo>> newMessages;
-        for (const QMailMessageId &messageId : _newMessages) {
-            if (QSharedPointer<MessageInfo> message = _publishedMessages.value(messageId)) {
-                newMessages.append(message);
-            }
+// Publishes the pending changes, if accountId is valid only its new messages are published
+void MailStoreObserver::publishMessages(const QMailAccountId &accountId)
+{
+    if (!_operations.isEmpty()) {
+        // Publish once the pending store changes have been applied
+        if (!_deferredPublications.contains(accountId)) {
+            _deferredPublications.append(accountId);
         }
+        return;
+    }
+
+    const bool firstSyncChanges = publishFirstSyncSummaries(accountId);
+
+    if (_publicationChanges && !_reloading) {
+        DiagnosticsTimer timer(Diagnostics::PublishChangesTime);
+        _changesTimer->stop();
 
-        _newMessages.clear();
+        const QVector<MessageInfo> newMessages(_publishedMessages.takeNewMessages(accountId));
+        _publicationChanges = _publishedMessages.hasNewMessages() || firstSyncChanges;
+
+        updateNotifications(newMessages);
+
+        // Time since the first of these messages was added, recorded once they are shown
+        const QElapsedTimer added(_firstNewMessage);
+        if (!_publishedMessages.hasNewMessages()) {
+            _firstNewMessage.invalidate();
+        }
+        auto recordLatency = [added](Notification *) {
+            Diagnostics::instance()->record(Diagnostics::PublishLatency, added.nsecsElapsed() / 1000);
+        };
 
         if (!newMessages.isEmpty()) {
             // Notify the user of new messages
             if (_appOnScreen) {
                 // just a simple feedback when app is on screen
-                Notification notification;
-                initNotification(&notification);
-                notification.setIsTransient(true);
-                notification.setHintValue("x-nemo-feedback", QStringLiteral("email"));
-                notification.publish();
+                Notification *notification = new Notification(this);
+                initNotification(notification);
+                notification->setIsTransient(true);
+                notification->setHintValue("x-nemo-feedback", QStringLiteral("email"));
+                _queue->publish(notification, [recordLatency](Notification *published) {
+                    recordLatency(published);
+                    published->deleteLater();
+                });
             } else {
                 Notification *summaryNotification = new Notification(this);
-                connect(summaryNotification, &Notification::closed,
-                        this, &MailStoreObserver::notificationClosed);
-                connect(summaryNotification, &Notification::actionInvoked,
-                        this, &MailStoreObserver::notificationActionInvoked);
+                QMailAccountId summaryAccountId;
 
                 initNotification(summaryNotification);
                 summaryNotification->setIsTransient(true);
                 summaryNotification->setHintValue("x-nemo-feedback", QStringLiteral("email"));
 
                 if (newMessages.count() == 1) {
-                    const QSharedPointer<MessageInfo> message = newMessages.first();
+                    const MessageInfo &message(newMessages.first());
+                    summaryAccountId = message.accountId;
 
-                    summaryNotification->setPreviewSummary(message->sender.isEmpty() ? message->origin : message->sender);
-                    summaryNotification->setPreviewBody(message->subject);
-                    summaryNotification->setRemoteActions(singleMessageRemoteActionList(summaryNotification, *message));
+                    summaryNotification->setPreviewSummary(message.sender.isEmpty() ? message.origin : message.sender);
+                    summaryNotification->setPreviewBody(message.subject);
+                    summaryNotification->setRemoteActions(messageRemoteActions(summaryNotification, message));
 
                     // Override the icon to be the icon associated with this account
-                    QMailAccount account(message->accountId);
-                    summaryNotification->setAppIcon(account.iconPath());
+                    summaryNotification->setAppIcon(_accounts->iconPath(message.accountId));
                 } else {
                     //: Summary of new email(s) notification
                     //% "You have %n new email(s)"
@@ -401,33 +721,126 @@ void MailStoreObserver::publishChanges()
 
                     // Find if these messages are all for the same account
                     QMailAccountId firstAccountId;
-                    for (const QSharedPointer<MessageInfo> &message : newMessages) {
+                    for (const MessageInfo &message : newMessages) {
                         if (!firstAccountId.isValid()) {
-                            firstAccountId = message->accountId;
-                        } else if (message->accountId != firstAccountId) {
+                            firstAccountId = message.accountId;
+                        } else if (message.accountId != firstAccountId) {
                             firstAccountId = QMailAccountId();
                             break;
                         }
                     }
 
+                    summaryAccountId = firstAccountId;
                     if (firstAccountId.isValid()) {
                         // Show the inbox for this account
                         const QVariant varId(static_cast<int>(firstAccountId.toULongLong()));
-                        summaryNotification->setRemoteAction(::remoteAction("default", QString(), "openInbox",
-                                                                            QVariantList() << varId));
+                        summaryNotification->setRemoteAction(::remoteAction(remoteActions().openInbox, varId));
 
                         // Also override the icon to be the icon associated with this account
-                        QMailAccount account(firstAccountId);
-                        summaryNotification->setAppIcon(account.iconPath());
+                        summaryNotification->setAppIcon(_accounts->iconPath(firstAccountId));
                     } else {
                         // Multiple accounts - show the combined inbox
-                        summaryNotification->setRemoteAction(::remoteAction("default", QString(), "openCombinedInbox"));
+                        summaryNotification->setRemoteAction(remoteActions().openCombinedInbox);
                     }
                 }
 
-                summaryNotification->publish();
+                _queue->publish(summaryNotification, recordLatency);
+                trackNotification(summaryNotification, NotificationRegistry::SummaryNotification, summaryAccountId);
             }
         }
+
+        if (!_snapshotTimer->isActive()) {
+            _snapshotTimer->start();
+        }
+    }
+}
+
+// Publishes the summaries of the accounts in their first sync, if accountId is valid
+// only its summary. Returns true if summaries of other accounts are still pending.
+bool MailStoreObserver::publishFirstSyncSummaries(const QMailAccountId &accountId)
+{
+    bool pending = false;
+    QHash<QMailAccountId, FirstSync>::iterator it = _firstSyncs.begin();
+    while (it != _firstSyncs.end()) {
+        if (accountId.isValid() && it.key() != accountId) {
+            pending = pending || it->changed;
+            ++it;
+            continue;
+        }
+
+        Notification *summary = firstSyncNotification(it.key());
+        if (it->changed) {
+            if (!it->ids.isEmpty()) {
+                publishFirstSyncSummary(it.key(), it->ids.count());
+            } else if (summary) {
+                // All the counted messages were read or removed
+                closeNotification(summary);
+            }
+            it->changed = false;
+        }
+
+        // Folder lists are retrieved before the messages, the first
+        // sync is only done once the account has been synchronized.
+        // The counted messages are followed while the summary is shown.
+        it->done = it->done || _accounts->isSynchronized(it.key());
+        if (it->done && (it->ids.isEmpty() || !firstSyncNotification(it.key()))) {
+            it = _firstSyncs.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    return pending;
+}
+
+void MailStoreObserver::publishFirstSyncSummary(const QMailAccountId &accountId, int count)
+{
+    Notification *summary = new Notification(this);
+    initNotification(summary);
+    summary->setAppName(_accounts->name(accountId));
+    summary->setAppIcon(_accounts->iconPath(accountId));
+    summary->setHintValue(firstSyncAccountId, accountId.toULongLong());
+    summary->setSummary(qtTrId("qmf-notification_new_email_banner_notification", count));
+    summary->setBody(_accounts->name(accountId));
+    summary->setRemoteAction(::remoteAction(remoteActions().openInbox, static_cast<int>(accountId.toULongLong())));
+
+    if (Notification *existing = firstSyncNotification(accountId)) {
+        replaceNotification(existing, summary);
+    }
+
+    _queue->publish(summary);
+    trackNotification(summary, NotificationRegistry::FirstSyncNotification, accountId);
+}
+
+Notification *MailStoreObserver::firstSyncNotification(const QMailAccountId &accountId) const
+{
+    for (Notification *notification : _notifications.accountNotifications(accountId)) {
+        if (_notifications.entry(notification).kind == NotificationRegistry::FirstSyncNotification) {
+            return notification;
+        }
+    }
+    return 0;
+}
+
+bool MailStoreObserver::isFirstSyncMessage(const QMailMessageId &id) const
+{
+    for (const FirstSync &firstSync : _firstSyncs) {
+        if (firstSync.ids.contains(id)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Drops a counted message that was read or removed, the summary is
+// published again with the lower count
+void MailStoreObserver::removeFirstSyncMessage(const QMailMessageId &id)
+{
+    for (FirstSync &firstSync : _firstSyncs) {
+        if (firstSync.ids.remove(id)) {
+            firstSync.changed = true;
+            _publicationChanges = true;
+            return;
+        }
     }
 }
 
@@ -435,6 +848,7 @@ void MailStoreObserver::notificationClosed(uint reason)
 {
     Q_UNUSED(reason)
     Notification *notification = qobject_cast<Notification*>(sender());
+    _notifications.remove(notification);
     notification->deleteLater();
 }
 
@@ -443,78 +857,460 @@ void MailStoreObserver::notificationActionInvoked(const QString &name)
     Notification *notification = qobject_cast<Notification*>(sender());
     const int messageId = notification->property("messageId").toInt();
     if (name == markAsReadAction) {
-        EmailAgent *agent = EmailAgent::instance();
-        agent->markMessageAsRead(messageId);
+        const NotificationRegistry::Entry entry(_notifications.entry(notification));
+        if (entry.kind == NotificationRegistry::GroupNotification) {
+            // Marks the whole conversation as read
+            for (const QMailMessageId &id : _groupMessages.value(entry.groupKey)) {
+                markAsRead(id);
+            }
+        } else {
+            markAsRead(QMailMessageId(messageId));
+        }
+        scheduleChanges();
+        _markAsReadTimer->start();
     }
 }
 
-void MailStoreObserver::addMessages(const QMailMessageIdList &ids)
+void MailStoreObserver::markPendingAsRead()
 {
-    clearFoldersToSync();
+    _markAsReadTimer->stop();
+    if (_pendingReads.isEmpty()) {
+        return;
+    }
+
+    QSet<QMailAccountId> accountIds;
+    for (const QMailAccountId &accountId : _pendingReads) {
+        accountIds.insert(accountId);
+    }
+    const QMailMessageIdList ids(_pendingReads.keys());
+    _pendingReads.clear();
 
+    Diagnostics::instance()->increment(Diagnostics::StoreQueries);
+    if (!_storage->updateMessagesMetaData(QMailMessageKey::id(ids), QMailMessage::Read, true)) {
+        qWarning() << Q_FUNC_INFO << "Cannot mark" << ids.count() << "messages as read";
+        return;
+    }
+    EmailAgent::instance()->exportUpdates(accountIds.toList());
+}
+
+void MailStoreObserver::saveSnapshot()
+{
+    if (!writeSnapshot()) {
+        _snapshotTimer->start();
+    }
+}
+
+void MailStoreObserver::messagesLoaded(quint64 serial, const MessageInfoList &messages,
+                                       const CountedMessages &counted)
+{
+    for (StoreOperation &operation : _operations) {
+        if (operation.serial == serial) {
+            operation.messages = messages;
+            operation.counted = counted;
+            operation.loaded = true;
+            break;
+        }
+    }
+    processOperations();
+}
+
+void MailStoreObserver::addMessages(const QMailMessageIdList &ids)
+{
     for (const QMailMessageId &id : ids) {
-        const QMailMessageMetaData message(id);
+        ++_loadingMessages[id];
+    }
+    // Publish latency is measured from the store signal, the load is part of it
+    if (!_firstNewMessage.isValid()) {
+        _firstNewMessage.start();
+    }
+    enqueueOperation(StoreOperation::AddMessages, ids, true);
+}
 
+void MailStoreObserver::applyAddedMessages(const StoreOperation &operation)
+{
+    DiagnosticsTimer timer(Diagnostics::AddMessagesTime);
+
+    for (const QMailMessageId &id : operation.ids) {
+        QHash<QMailMessageId, int>::iterator it = _loadingMessages.find(id);
+        if (it != _loadingMessages.end() && --(*it) == 0) {
+            _loadingMessages.erase(it);
+        }
+    }
+
+    for (const MessageInfo &message : operation.messages) {
         // Workaround for plugin that try to add same message twice
-        if (shouldNotify(message) && !_publishedMessages.contains(id)) {
-            _publishedMessages.insert(id, constructMessageInfo(message));
-            _newMessages.insert(id);
+        if (_publishedMessages.contains(message.id) || isKnownCopy(message.id)) {
+            continue;
+        }
+
+        // The same message delivered to another account is not notified again
+        const QMailMessageId original(_duplicateKeys.value(duplicateKey(message)));
+        if (original.isValid()) {
+            MessageCopy messageCopy;
+            messageCopy.original = original;
+            messageCopy.message = message;
+            _copyOf.insert(message.id, messageCopy);
+            _copies.insert(original, message.id);
+            Diagnostics::instance()->increment(Diagnostics::DuplicateMessages);
+            continue;
+        }
+
+        insertMessage(message, true);
+        _publicationChanges = true;
+    }
+    // None of the added messages are going to be published
+    if (_loadingMessages.isEmpty() && !_publishedMessages.hasNewMessages()) {
+        _firstNewMessage.invalidate();
+    }
+
+    for (CountedMessages::const_iterator it = operation.counted.constBegin(); it != operation.counted.constEnd(); ++it) {
+        QHash<QMailAccountId, FirstSync>::iterator firstSync = _firstSyncs.find(QMailAccountId(it.key()));
+        if (firstSync != _firstSyncs.end()) {
+            for (quint64 id : it.value()) {
+                firstSync->ids.insert(QMailMessageId(id));
+            }
+            firstSync->changed = true;
             _publicationChanges = true;
         }
     }
 }
 
+void MailStoreObserver::accountsAdded(const QMailAccountIdList &ids)
+{
+    for (const QMailAccountId &accountId : ids) {
+        _firstSyncs.insert(accountId, FirstSync());
+    }
+}
+
+void MailStoreObserver::accountsRemoved(const QMailAccountIdList &ids)
+{
+    for (const QMailAccountId &accountId : ids) {
+        _firstSyncs.remove(accountId);
+    }
+}
+
 void MailStoreObserver::removeMessages(const QMailMessageIdList &ids)
 {
+    QMailMessageIdList knownIds;
     for (const QMailMessageId &id : ids) {
-        if (_publishedMessages.contains(id)) {
+        // Messages still being reloaded are checked once their reload is applied
+        if (_publishedMessages.contains(id) || _loadingMessages.contains(id) || isKnownCopy(id)
+                || _reloadedNotifications.contains(id) || _reloadedMembers.contains(id)
+                || isFirstSyncMessage(id)) {
+            knownIds.append(id);
+        }
+    }
+
+    if (!knownIds.isEmpty()) {
+        enqueueOperation(StoreOperation::RemoveMessages, knownIds, false);
+    }
+}
+
+void MailStoreObserver::applyRemovedMessages(const StoreOperation &operation)
+{
+    DiagnosticsTimer timer(Diagnostics::RemoveMessagesTime);
+
+    for (const QMailMessageId &id : operation.ids) {
+        if (_publishedMessages.contains(id) || isKnownCopy(id)) {
             removeMessage(id);
             _publicationChanges = true;
         }
+        removeFirstSyncMessage(id);
+    }
+    scheduleChanges();
+}
+
+void MailStoreObserver::applyReloadedMessages(const StoreOperation &operation)
+{
+    // Group members restored from the snapshot, by the message of their notification
+    QMultiHash<QMailMessageId, QMailMessageId> members;
+    QSet<QMailMessageId> memberIds;
+    for (const QMailMessageId &messageId : operation.ids) {
+        const QMailMessageId shownId(_reloadedMembers.take(messageId));
+        if (shownId.isValid()) {
+            members.insert(shownId, messageId);
+            memberIds.insert(messageId);
+        }
+    }
+
+    for (const MessageInfo &message : operation.messages) {
+        // Messages added since the reload started are already known
+        if ((_reloadedNotifications.contains(message.id) || memberIds.contains(message.id))
+                && !_publishedMessages.contains(message.id)) {
+            insertMessage(message, false);
+        }
+    }
+
+    // Keep the notifications of still published messages, close the rest
+    for (const QMailMessageId &messageId : operation.ids) {
+        Notification *notification = _reloadedNotifications.take(messageId);
+        if (!notification) {
+            // Closed meanwhile, or a member of a group
+            continue;
+        }
+
+        // A group notification stays with the remaining members of the group
+        const QMailMessageIdList groupIds(members.values(messageId));
+        QMailMessageId shownId(messageId);
+        bool groupChanged = false;
+        for (const QMailMessageId &id : groupIds) {
+            if (!_publishedMessages.contains(id)) {
+                groupChanged = true;
+            } else if (!_publishedMessages.contains(shownId)) {
+                shownId = id;
+            }
+        }
+        groupChanged = groupChanged || shownId != messageId;
+
+        if (_publishedMessages.contains(shownId) && !messageNotification(shownId)) {
+            adoptNotification(notification, shownId);
+            if (groupChanged) {
+                // Publish the group again with its current item count
+                _changedGroups.insert(groupKey(_publishedMessages.message(shownId)));
+                _publicationChanges = true;
+            }
+        } else {
+            _queue->close(notification);
+            delete notification;
+        }
+    }
+
+    if (--_pendingReloads == 0) {
+        finishReload();
+    }
+}
+
+// Publishes the notification of a group in place of its existing one,
+// it shows the number of messages and the latest of them
+void MailStoreObserver::publishGroupNotification(const QString &groupKey, bool hasNewMessages, bool feedback)
+{
+    Notification *existing = _notifications.groupNotification(groupKey);
+    const QSet<QMailMessageId> ids(_groupMessages.value(groupKey));
+    if (ids.isEmpty()) {
+        if (existing) {
+            closeNotification(existing);
+        }
+        return;
+    } else if (!existing && !hasNewMessages) {
+        // Dismissed, don't bring it back for messages being read, unless it
+        // takes over a message shown in another group
+        bool promoted = false;
+        for (const QMailMessageId &id : ids) {
+            promoted = promoted || _promotedMessages.contains(id);
+        }
+        if (!promoted) {
+            return;
+        }
+    }
+
+    MessageInfo latest;
+    for (const QMailMessageId &id : ids) {
+        const MessageInfo message(_publishedMessages.message(id));
+        if (!latest.id.isValid() || message.timeStamp > latest.timeStamp) {
+            latest = message;
+        }
+    }
+
+    Notification *notification = new Notification(this);
+    initNotification(notification);
+    notification->setAppName(_accounts->name(latest.accountId));
+    notification->setAppIcon(_accounts->iconPath(latest.accountId));
+    if (!hasNewMessages) {
+        notification->setHintValue(QStringLiteral("x-nemo-display-on"), false);
+    }
+    if (feedback) {
+        notification->setHintValue("x-nemo-feedback", "email_exists");
+    }
+    notification->setHintValue(publishedMessageId, QString::number(latest.id.toULongLong()));
+    notification->setSummary(latest.sender.isEmpty() ? latest.origin : latest.sender);
+    notification->setBody(latest.subject);
+    notification->setUrgency(Notification::Low);
+    notification->setTimestamp(latest.timeStamp);
+    notification->setItemCount(ids.count());
+    notification->setRemoteActions(messageRemoteActions(notification, latest));
+
+    if (existing) {
+        replaceNotification(existing, notification);
+    }
+
+    _queue->publish(notification);
+    trackNotification(notification, NotificationRegistry::GroupNotification, latest.accountId, latest.id, groupKey);
+}
+
+void MailStoreObserver::insertMessage(const MessageInfo &message, bool isNew)
+{
+    _publishedMessages.insert(message, isNew);
+    const QByteArray key(duplicateKey(message));
+    if (!_duplicateKeys.contains(key)) {
+        _duplicateKeys.insert(key, message.id);
+        _messageKeys.insert(message.id, key);
+    }
+    if (_grouping) {
+        _groupMessages[groupKey(message)].insert(message.id);
+    }
+    // A message added back replaces its existing notification instead
+    _removedMessages.remove(message.id);
+
+    // Limit the maximum number of notifications published for each account
+    // by removing the notifications for the earliest messages of the account
+    while (_publishedMessages.accountCount(message.accountId) > MaxNotificationsPerAccount) {
+        removeMessage(_publishedMessages.earliestMessage(message.accountId));
     }
-    emit mailStoreChanges();
 }
 
 void MailStoreObserver::removeMessage(const QMailMessageId &id)
 {
-    _publishedMessages.remove(id);
-    _newMessages.remove(id);
+    // Reading or removing a copy leaves the published message as it is
+    QHash<QMailMessageId, MessageCopy>::iterator copy = _copyOf.find(id);
+    if (copy != _copyOf.end()) {
+        _copies.remove(copy->original, id);
+        _copyOf.erase(copy);
+        return;
+    }
+
+    const bool shown = _copies.contains(id) && messageNotification(id);
+    const bool isNew = _publishedMessages.isNew(id);
+
+    if (_grouping && _publishedMessages.contains(id)) {
+        const QString key(groupKey(_publishedMessages.message(id)));
+        QHash<QString, QSet<QMailMessageId> >::iterator it = _groupMessages.find(key);
+        if (it != _groupMessages.end()) {
+            it->remove(id);
+            if (it->isEmpty()) {
+                _groupMessages.erase(it);
+            }
+        }
+        _changedGroups.insert(key);
+    }
+
+    if (_publishedMessages.remove(id)) {
+        _removedMessages.insert(id);
+        _duplicateKeys.remove(_messageKeys.take(id));
+        promoteCopy(id, shown, isNew);
+    }
+}
+
+// Publishes a remaining copy of a message that went away in its place,
+// the other copies become copies of it. The copy takes over the
+// notification of the message if it was shown, or is published as new
+// if the message was not published yet.
+void MailStoreObserver::promoteCopy(const QMailMessageId &original, bool shown, bool isNew)
+{
+    const QMailMessageIdList copyIds(_copies.values(original));
+    if (copyIds.isEmpty()) {
+        return;
+    }
+    _copies.remove(original);
+
+    const MessageInfo message(_copyOf.take(copyIds.first()).message);
+    for (int i = 1; i < copyIds.count(); ++i) {
+        _copyOf[copyIds.at(i)].original = message.id;
+        _copies.insert(message.id, copyIds.at(i));
+    }
+
+    // The original may itself have taken over a notification not replaced yet
+    const QMailMessageId shownId(_promotedMessages.take(original));
+    if (!isNew && (shown || shownId.isValid())) {
+        _promotedMessages.insert(message.id, shownId.isValid() ? shownId : original);
+    }
+    if (_grouping) {
+        _changedGroups.insert(groupKey(message));
+    }
+    insertMessage(message, isNew);
+    Diagnostics::instance()->increment(Diagnostics::PromotedCopies);
+}
+
+bool MailStoreObserver::isKnownCopy(const QMailMessageId &id) const
+{
+    return _copyOf.contains(id);
+}
+
+// Queues a published message and its copies to be marked as read. They are
+// no longer published from now on, so the store update resulting from this
+// is ignored instead of being loaded again.
+void MailStoreObserver::markAsRead(const QMailMessageId &id)
+{
+    if (!_publishedMessages.contains(id)) {
+        return;
+    }
+
+    // Its copies are read as well, none of them takes over
+    _pendingReads.insert(id, _publishedMessages.accountId(id));
+    for (const QMailMessageId &copyId : _copies.values(id)) {
+        _pendingReads.insert(copyId, _copyOf.take(copyId).message.accountId);
+    }
+    _copies.remove(id);
+    removeMessage(id);
+    _publicationChanges = true;
 }
 
 void MailStoreObserver::updateMessages(const QMailMessageIdList &ids)
 {
     // TODO: notify messages that we already have and change the status
     // from read to unread ???
-    clearFoldersToSync();
 
+    // Messages still being added or reloaded are checked again as well,
+    // their load may have happened before the update
+    QMailMessageIdList publishedIds;
     for (const QMailMessageId &id : ids) {
-        if (_publishedMessages.contains(id)) {
-            // Check if message was read
-            const QMailMessageMetaData message(id);
-            if (!shouldNotify(message)) {
-                removeMessage(id);
-                _publicationChanges = true;
-            }
+        if (_publishedMessages.contains(id) || _loadingMessages.contains(id) || isKnownCopy(id)
+                || _reloadedNotifications.contains(id) || _reloadedMembers.contains(id)
+                || isFirstSyncMessage(id)) {
+            publishedIds.append(id);
         }
     }
-    emit mailStoreChanges();
+
+    if (!publishedIds.isEmpty()) {
+        enqueueOperation(StoreOperation::UpdateMessages, publishedIds, true);
+    }
 }
 
-void MailStoreObserver::transmitCompleted(const QMailAccountId &accountId)
+void MailStoreObserver::applyUpdatedMessages(const StoreOperation &operation)
 {
-    const QVariant acctId(accountId.toULongLong());
+    DiagnosticsTimer timer(Diagnostics::UpdateMessagesTime);
 
-    // If there is an existing failure for this notification, remove it
-    QList<QObject *> existingNotifications(Notification::notifications());
-    for (QObject *obj : existingNotifications) {
-        if (Notification *notification = qobject_cast<Notification *>(obj)) {
-            if (notification->hintValue("x-nemo.email.sendFailed-accountId") == accountId) {
-                notification->close();
-                break;
-            }
+    // Check if messages were read
+    QSet<QMailMessageId> notifiable;
+    for (const MessageInfo &message : operation.messages) {
+        notifiable.insert(message.id);
+    }
+    for (const QMailMessageId &id : operation.ids) {
+        if (notifiable.contains(id)) {
+            continue;
         }
+        if (_publishedMessages.contains(id) || isKnownCopy(id)) {
+            removeMessage(id);
+            _publicationChanges = true;
+        }
+        removeFirstSyncMessage(id);
+    }
+    scheduleChanges();
+}
+
+// Coalesces consecutive store changes into a single mailStoreChanges() signal.
+// Changes to the same message within the window are merged by the pending
+// state, e.g. a message added and removed again is not published at all.
+void MailStoreObserver::scheduleChanges()
+{
+    if (!_publicationChanges) {
+        return;
+    }
+
+    if (!_changesTimer->isActive()) {
+        _firstChange.start();
+        _changesTimer->start(ChangesCoalesceDelay);
+    } else {
+        const qint64 remaining = MaxChangesLatency - _firstChange.elapsed();
+        _changesTimer->start(static_cast<int>(qBound<qint64>(0, remaining, ChangesCoalesceDelay)));
+    }
+}
+
+void MailStoreObserver::transmitCompleted(const QMailAccountId &accountId)
+{
+    // If there is an existing failure for this notification, remove it
+    if (Notification *notification = _notifications.sendFailedNotification(accountId)) {
+        closeNotification(notification);
     }
-    qDeleteAll(existingNotifications);
 }
 
 void MailStoreObserver::transmitFailed(const QMailAccountId &accountId)
@@ -524,12 +1320,12 @@ void MailStoreObserver::transmitFailed(const QMailAccountId &accountId)
     QMailMessageKey outboxFilter(QMailMessageKey::status(QMailMessage::Outbox)
                                  & ~QMailMessageKey::status(QMailMessage::Trash));
     QMailMessageKey accountKey(QMailMessageKey::parentAccountId(accountId));
+    Diagnostics::instance()->increment(Diagnostics::StoreQueries);
     if (!QMailStore::instance()->countMessages(accountKey & outboxFilter)) {
         return;
     }
 
-    QMailAccount account(accountId);
-    QString accountName = account.name();
+    QString accountName = _accounts->name(accountId);
     QVariant acctId = static_cast<int>(accountId.toULongLong());
 
     //: Summary of email sending failed notification
@@ -539,26 +1335,20 @@ void MailStoreObserver::transmitFailed(const QMailAccountId &accountId)
     //% "Account %1"
     QString body = qtTrId("qmf-notification_send_failed_Body").arg(accountName);
 
-    Notification sendFailure;
-    initNotification(&sendFailure);
-    sendFailure.setHintValue("x-nemo.email.sendFailed-accountId", accountId.toULongLong());
-    sendFailure.setSummary(summary);
-    sendFailure.setBody(body);
-    sendFailure.setRemoteAction(::remoteAction("default", QString(), "openOutbox", QVariantList() << acctId));
+    Notification *sendFailure = new Notification(this);
+    initNotification(sendFailure);
+    sendFailure->setHintValue(sendFailedAccountId, accountId.toULongLong());
+    sendFailure->setSummary(summary);
+    sendFailure->setBody(body);
+    sendFailure->setRemoteAction(::remoteAction(remoteActions().openOutbox, acctId));
 
     // If there is an existing failure for this notification, replace it
-    QList<QObject *> existingNotifications(Notification::notifications());
-    for (QObject *obj : existingNotifications) {
-        if (Notification *notification = qobject_cast<Notification *>(obj)) {
-            if (notification->hintValue("x-nemo.email.sendFailed-accountId") == accountId) {
-                sendFailure.setReplacesId(notification->replacesId());
-                break;
-            }
-        }
+    if (Notification *notification = _notifications.sendFailedNotification(accountId)) {
+        replaceNotification(notification, sendFailure);
     }
-    qDeleteAll(existingNotifications);
 
-    sendFailure.publish();
+    _queue->publish(sendFailure);
+    trackNotification(sendFailure, NotificationRegistry::SendFailedNotification, accountId);
 }
 
 void MailStoreObserver::setNotifyOn()
@@ -583,24 +1373,3 @@ void MailStoreObserver::accountInboxDisplayed(int accountId)
         closeAccountNotifications(acctId);
     }
 }
-
-void MailStoreObserver::clearFoldersToSync()
-{
-    _tempFoldersToSync.clear();
-}
-
-bool MailStoreObserver::messageInFolderToSync(const QMailMessageMetaData &message)
-{
-    QMailAccountId accountId = message.parentAccountId();
-    QMailFolderId folderId = message.parentFolderId();
-
-    // Optimise by only getting the folder list once for each account
-    if (_tempFoldersToSync.contains(accountId)) {
-        QList<QMailFolderId> const &folders = _tempFoldersToSync.value(accountId);
-        return folders.contains(folderId);
-    } else {
-        QList<QMailFolderId> const &folders = QMailAccount(accountId).foldersToSync();
-        _tempFoldersToSync.insert(accountId, folders);
-        return folders.contains(folderId);
-    }
-}
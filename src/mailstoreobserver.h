@@ -35,6 +35,12 @@
 #ifndef MAILSTOREOBSERVER_H
 #define MAILSTOREOBSERVER_H
 
+#include "accountcache.h"
+#include "messageloader.h"
+#include "notificationqueue.h"
+#include "notificationregistry.h"
+#include "publishedmessages.h"
+
 // nemonotifications-qt5
 #include <notification.h>
 
@@ -42,32 +48,28 @@
 #include <qmailstore.h>
 
 // Qt
+#include <QElapsedTimer>
 #include <QObject>
+#include <QQueue>
 #include <QString>
-#include <QSharedPointer>
+#include <QVariantMap>
+#include <QVector>
 
-struct MessageInfo
-{
-    QMailMessageId id;
-    QString origin;
-    QString sender;
-    QString subject;
-    QDateTime timeStamp;
-    QMailAccountId accountId;
-    bool hasMultipleRecipients;
-};
+class QTimer;
 
 class MailStoreObserver : public QObject
 {
     Q_OBJECT
 public:
-    explicit MailStoreObserver(QObject *parent = 0);
+    explicit MailStoreObserver(AccountCache *accounts, QObject *parent = 0);
+    ~MailStoreObserver();
 
 signals:
     void mailStoreChanges();
 
 public slots:
     void publishChanges();
+    void publishAccountChanges(const QMailAccountId &accountId);
     void transmitCompleted(const QMailAccountId &accountId);
     void transmitFailed(const QMailAccountId &accountId);
 
@@ -75,32 +77,149 @@ private slots:
     void addMessages(const QMailMessageIdList &ids);
     void removeMessages(const QMailMessageIdList &ids);
     void updateMessages(const QMailMessageIdList &ids);
+    void accountsAdded(const QMailAccountIdList &ids);
+    void accountsRemoved(const QMailAccountIdList &ids);
     void setNotifyOn();
     void setNotifyOff();
     void combinedInboxDisplayed();
     void accountInboxDisplayed(int accountId);
-    
+    void resyncNotifications();
+    void messagesLoaded(quint64 serial, const MessageInfoList &messages, const CountedMessages &counted);
+    void saveSnapshot();
+    void markPendingAsRead();
+
 private:
-    typedef QHash<QMailMessageId, QSharedPointer<MessageInfo> > MessageHash;
+    // Store change waiting for its messages to be loaded, applied in arrival order
+    struct StoreOperation
+    {
+        enum Type {
+            AddMessages,
+            UpdateMessages,
+            RemoveMessages,
+            ReloadMessages
+        };
+
+        Type type;
+        QMailMessageIdList ids;
+        quint64 serial;
+        bool loaded;
+        MessageInfoList messages;
+        CountedMessages counted;
+    };
+
+    // Accounts added while running only have their new messages counted
+    // until they have been synchronized once, the summary follows the
+    // counted messages until they are read or removed
+    struct FirstSync
+    {
+        QSet<QMailMessageId> ids;
+        bool changed = false;
+        bool done = false;
+    };
+
+    // Remote actions built on first use with the translations installed at
+    // plugin start, only their arguments differ between notifications
+    struct RemoteActions
+    {
+        QVariantMap openMessage;
+        QVariantMap reply;
+        QVariantMap replyAll;
+        QVariantMap markAsRead;
+        QVariantMap openInbox;
+        QVariantMap openCombinedInbox;
+        QVariantMap openOutbox;
+    };
+
+    struct MessageCopy
+    {
+        QMailMessageId original;
+        // Published in place of the original if the original goes away
+        MessageInfo message;
+    };
 
     bool _publicationChanges;
     bool _appOnScreen;
     QMailStore *_storage;
-    MessageHash _publishedMessages;
-    QSet<QMailMessageId> _newMessages;
-    QHash<QMailAccountId, QList<QMailFolderId>> _tempFoldersToSync;
+    AccountCache *_accounts;
+    QTimer *_changesTimer;
+    QTimer *_snapshotTimer;
+    QTimer *_markAsReadTimer;
+    QElapsedTimer _firstChange;
+    QElapsedTimer _firstNewMessage;
+    NotificationQueue *_queue;
+    MessageLoader *_loader;
+    QQueue<StoreOperation> _operations;
+    // Ids of the messages in pending add operations
+    QHash<QMailMessageId, int> _loadingMessages;
+    QList<QMailAccountId> _deferredPublications;
+    bool _reloading;
+    int _pendingReloads;
+    QElapsedTimer _reloadTimer;
+    QHash<QMailMessageId, Notification *> _reloadedNotifications;
+    // Other members of the reloaded group notifications, by the message of their notification
+    QHash<QMailMessageId, QMailMessageId> _reloadedMembers;
+    QHash<QMailAccountId, FirstSync> _firstSyncs;
+    // Messages notified together when grouping by conversation
+    bool _grouping;
+    QHash<QString, QSet<QMailMessageId> > _groupMessages;
+    QSet<QString> _changedGroups;
+    // Copies of published messages delivered to several accounts, they
+    // share the notification of the published message
+    QHash<QByteArray, QMailMessageId> _duplicateKeys;
+    QHash<QMailMessageId, QByteArray> _messageKeys;
+    QHash<QMailMessageId, MessageCopy> _copyOf;
+    QMultiHash<QMailMessageId, QMailMessageId> _copies;
+    // Copies published in place of their original, with the message
+    // whose notification they take over
+    QHash<QMailMessageId, QMailMessageId> _promotedMessages;
+    // Messages marked as read from notifications, updated together
+    QHash<QMailMessageId, QMailAccountId> _pendingReads;
+    PublishedMessages _publishedMessages;
+    QSet<QMailMessageId> _removedMessages;
+    NotificationRegistry _notifications;
+    RemoteActions _remoteActions;
+
+    const RemoteActions &remoteActions();
+    QVariantList messageRemoteActions(Notification *notification, const MessageInfo &messageInfo);
 
     void reloadNotifications();
+    void finishReload();
+    bool writeSnapshot();
+    void trackNotification(Notification *notification, NotificationRegistry::Kind kind,
+                           const QMailAccountId &accountId, const QMailMessageId &messageId = QMailMessageId(),
+                           const QString &groupKey = QString());
+    void adoptNotification(Notification *notification, const QMailMessageId &messageId);
+    Notification *messageNotification(const QMailMessageId &messageId) const;
+    QString groupKey(const MessageInfo &message) const;
+    void publishGroupNotification(const QString &groupKey, bool hasNewMessages, bool feedback);
+    void publishMessageNotification(const MessageInfo &message, Notification *existing,
+                                    bool isNew, bool feedback);
+    void closeNotification(Notification *notification);
+    void replaceNotification(Notification *existing, Notification *notification);
     void closeNotifications();
     void closeAccountNotifications(const QMailAccountId &accountId);
     void notificationClosed(uint reason);
     void notificationActionInvoked(const QString &name);
-    QSharedPointer<MessageInfo> constructMessageInfo(const QMailMessageMetaData &message);
-    bool shouldNotify(const QMailMessageMetaData &message);
-    void updateNotifications();
-    void clearFoldersToSync();
-    bool messageInFolderToSync(const QMailMessageMetaData &message);
+    MessageFilter notifiableMessagesFilter();
+    void enqueueOperation(StoreOperation::Type type, const QMailMessageIdList &ids, bool load);
+    void processOperations();
+    void applyAddedMessages(const StoreOperation &operation);
+    void applyUpdatedMessages(const StoreOperation &operation);
+    void applyRemovedMessages(const StoreOperation &operation);
+    void applyReloadedMessages(const StoreOperation &operation);
+    void publishMessages(const QMailAccountId &accountId);
+    bool publishFirstSyncSummaries(const QMailAccountId &accountId);
+    void publishFirstSyncSummary(const QMailAccountId &accountId, int count);
+    Notification *firstSyncNotification(const QMailAccountId &accountId) const;
+    bool isFirstSyncMessage(const QMailMessageId &id) const;
+    void removeFirstSyncMessage(const QMailMessageId &id);
+    void updateNotifications(const QVector<MessageInfo> &newMessages);
+    void insertMessage(const MessageInfo &message, bool isNew);
     void removeMessage(const QMailMessageId &id);
+    void promoteCopy(const QMailMessageId &original, bool shown, bool isNew);
+    bool isKnownCopy(const QMailMessageId &id) const;
+    void markAsRead(const QMailMessageId &id);
+    void scheduleChanges();
 };
 
 #endif // MAILSTOREOBSERVER_H
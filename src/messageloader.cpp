@@ -0,0 +1,375 @@
+/*
+ * Copyright (c) 2026 Jolla Ltd.
+ *
+ * This file is part of qmf-notifications-plugin
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+#include "messageloader.h"
+#include "diagnostics.h"
+
+// QMF
+#include <qmailnamespace.h>
+#include <qmailstore.h>
+
+// Qt
+#include <QDebug>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QStringList>
+#include <QThread>
+
+namespace {
+
+const auto databaseConnection = QStringLiteral("qmf-notifications-loader");
+
+// Upper bound for the number of ids in a single store query
+const int MaxIdsPerQuery = 500;
+
+// Versions of the QMF mailmessages table the queries are written for, its
+// columns and their encoding can change with any other version
+const int MinMessagesTableVersion = 112;
+const int MaxMessagesTableVersion = 114;
+
+// Message properties read by constructMessageInfo()
+const QMailMessageKey::Properties notificationProperties(QMailMessageKey::Id
+                                                         | QMailMessageKey::ParentAccountId
+                                                         | QMailMessageKey::Sender
+                                                         | QMailMessageKey::Recipients
+                                                         | QMailMessageKey::Subject
+                                                         | QMailMessageKey::TimeStamp
+                                                         | QMailMessageKey::ParentThreadId
+                                                         | QMailMessageKey::RfcId);
+
+MessageInfo constructMessageInfo(const QMailMessageId &id, const QMailAccountId &accountId,
+                                 const QMailAddress &from, const QString &subject,
+                                 const QDateTime &timeStamp, int recipientCount, quint64 threadId,
+                                 const QString &rfcId)
+{
+    MessageInfo messageInfo;
+    messageInfo.id = id;
+    messageInfo.origin = from.address().toLower();
+    messageInfo.sender = from.name();
+    messageInfo.subject = subject;
+    messageInfo.timeStamp = timeStamp;
+    messageInfo.accountId = accountId;
+    messageInfo.threadId = threadId;
+    messageInfo.rfcId = rfcId;
+    messageInfo.hasMultipleRecipients = recipientCount > 1;
+
+    return messageInfo;
+}
+
+// Returns the version QMF has recorded for the mailmessages table, or 0
+int messagesTableVersion(const QSqlDatabase &database)
+{
+    QSqlQuery query(database);
+    query.setForwardOnly(true);
+    if (!query.exec(QStringLiteral("SELECT MAX(versionNum) FROM versioninfo WHERE tableName = 'mailmessages'"))
+            || !query.next()) {
+        qWarning() << Q_FUNC_INFO << "Cannot read the mail store schema version" << query.lastError().text();
+        return 0;
+    }
+    return query.value(0).toInt();
+}
+
+QString idList(const QList<quint64> &ids)
+{
+    QStringList values;
+    values.reserve(ids.count());
+    for (quint64 id : ids) {
+        values.append(QString::number(id));
+    }
+    return values.join(QLatin1Char(','));
+}
+
+}
+
+QMailMessageKey MessageFilter::key() const
+{
+    QMailFolderIdList folders;
+    for (quint64 folderId : folderIds) {
+        folders.append(QMailFolderId(folderId));
+    }
+    if (folders.isEmpty()) {
+        return QMailMessageKey::nonMatchingKey();
+    }
+
+    QMailMessageKey key(QMailMessageKey::messageType(QMailMessage::Email)
+                        & ~QMailMessageKey::status(excludedStatus)
+                        & QMailMessageKey::parentFolderId(folders));
+    if (!countedAccounts.isEmpty()) {
+        QMailAccountIdList accounts;
+        for (quint64 accountId : countedAccounts) {
+            accounts.append(QMailAccountId(accountId));
+        }
+        key &= ~QMailMessageKey::parentAccountId(QMailAccountKey::id(accounts));
+    }
+    return key;
+}
+
+QMailMessageKey MessageFilter::countKey(quint64 accountId) const
+{
+    MessageFilter filter(*this);
+    filter.countedAccounts.clear();
+    return filter.key() & QMailMessageKey::parentAccountId(QMailAccountId(accountId));
+}
+
+MessageLoaderWorker::MessageLoaderWorker(const QString &databasePath)
+    : QObject()
+    , _databasePath(databasePath)
+    , _opened(false)
+{
+}
+
+MessageLoaderWorker::~MessageLoaderWorker()
+{
+    if (_opened) {
+        QSqlDatabase::database(databaseConnection, false).close();
+        QSqlDatabase::removeDatabase(databaseConnection);
+    }
+}
+
+// Opens the connection from the worker thread, it can only be used there
+bool MessageLoaderWorker::open()
+{
+    if (_opened) {
+        return true;
+    }
+
+    QSqlDatabase database(QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), databaseConnection));
+    database.setDatabaseName(_databasePath);
+    database.setConnectOptions(QStringLiteral("QSQLITE_OPEN_READONLY;QSQLITE_BUSY_TIMEOUT=1000"));
+    if (!database.open()) {
+        qWarning() << Q_FUNC_INFO << "Cannot open" << _databasePath << database.lastError().text();
+        database = QSqlDatabase();
+        QSqlDatabase::removeDatabase(databaseConnection);
+        return false;
+    }
+
+    const int version = messagesTableVersion(database);
+    if (version < MinMessagesTableVersion || version > MaxMessagesTableVersion) {
+        qWarning() << Q_FUNC_INFO << "Unknown mail store schema version" << version;
+        database.close();
+        database = QSqlDatabase();
+        QSqlDatabase::removeDatabase(databaseConnection);
+        return false;
+    }
+    _opened = true;
+    return true;
+}
+
+// Same selection as MessageFilter::key(), the ids are numbers and are
+// written directly into the statements
+void MessageLoaderWorker::load(quint64 serial, const QList<quint64> &ids, const MessageFilter &filter)
+{
+    if (!open()) {
+        emit failed(serial);
+        return;
+    }
+
+    MessageInfoList messages;
+    CountedMessages counted;
+    if (filter.folderIds.isEmpty()) {
+        emit loaded(serial, messages, counted);
+        return;
+    }
+
+    QSqlDatabase database(QSqlDatabase::database(databaseConnection, false));
+    const QString folders(idList(filter.folderIds));
+    const QString countedAccounts(idList(filter.countedAccounts));
+    for (int i = 0; i < ids.count(); i += MaxIdsPerQuery) {
+        const QString selection(QStringLiteral(" FROM mailmessages WHERE id IN (%1) AND type = ?"
+                                               " AND (status & ?) = 0 AND parentfolderid IN (%2)")
+                                .arg(idList(ids.mid(i, MaxIdsPerQuery)), folders));
+
+        if (!filter.countedAccounts.isEmpty()) {
+            QSqlQuery countQuery(database);
+            countQuery.setForwardOnly(true);
+            countQuery.prepare(QStringLiteral("SELECT parentaccountid, id") + selection
+                               + QStringLiteral(" AND parentaccountid IN (%1)").arg(countedAccounts));
+            countQuery.addBindValue(static_cast<int>(QMailMessage::Email));
+            countQuery.addBindValue(static_cast<qint64>(filter.excludedStatus));
+            if (!countQuery.exec()) {
+                qWarning() << Q_FUNC_INFO << "Cannot count messages" << countQuery.lastError().text();
+                emit failed(serial);
+                return;
+            }
+            while (countQuery.next()) {
+                counted[countQuery.value(0).toULongLong()].append(countQuery.value(1).toULongLong());
+            }
+        }
+
+        QSqlQuery query(database);
+        query.setForwardOnly(true);
+        query.prepare(QStringLiteral("SELECT id, parentaccountid, sender, recipients, subject, stamp, parentthreadid, rfcid") + selection
+                      + (filter.countedAccounts.isEmpty() ? QString()
+                                                          : QStringLiteral(" AND parentaccountid NOT IN (%1)")
+                                                            .arg(countedAccounts)));
+        query.addBindValue(static_cast<int>(QMailMessage::Email));
+        query.addBindValue(static_cast<qint64>(filter.excludedStatus));
+        if (!query.exec()) {
+            qWarning() << Q_FUNC_INFO << "Cannot load messages" << query.lastError().text();
+            emit failed(serial);
+            return;
+        }
+
+        while (query.next()) {
+            // Time stamps are stored in UTC
+            QDateTime timeStamp(query.value(5).toDateTime());
+            timeStamp.setTimeSpec(Qt::UTC);
+            messages.append(constructMessageInfo(QMailMessageId(query.value(0).toULongLong()),
+                                                 QMailAccountId(query.value(1).toULongLong()),
+                                                 QMailAddress(query.value(2).toString()),
+                                                 query.value(4).toString(), timeStamp,
+                                                 QMailAddress::fromStringList(query.value(3).toString()).count(),
+                                                 query.value(6).toULongLong(), query.value(7).toString()));
+        }
+    }
+
+    emit loaded(serial, messages, counted);
+}
+
+MessageLoader::MessageLoader(QObject *parent)
+    : QObject(parent)
+    , _thread(new QThread(this))
+    , _worker(new MessageLoaderWorker(databasePath()))
+    , _threaded(true)
+    , _lastSerial(0)
+{
+    qRegisterMetaType<MessageInfoList>("MessageInfoList");
+    qRegisterMetaType<CountedMessages>("CountedMessages");
+    qRegisterMetaType<MessageFilter>("MessageFilter");
+    qRegisterMetaType<QList<quint64> >("QList<quint64>");
+
+    _worker->moveToThread(_thread);
+    connect(_thread, &QThread::finished,
+            _worker, &QObject::deleteLater);
+    connect(this, &MessageLoader::loadRequested,
+            _worker, &MessageLoaderWorker::load);
+    connect(_worker, &MessageLoaderWorker::loaded,
+            this, &MessageLoader::workerLoaded);
+    connect(_worker, &MessageLoaderWorker::failed,
+            this, &MessageLoader::workerFailed);
+
+    _thread->setObjectName(QStringLiteral("qmf-notifications-loader"));
+    _thread->start(QThread::LowPriority);
+}
+
+MessageLoader::~MessageLoader()
+{
+    _thread->quit();
+    _thread->wait();
+}
+
+QString MessageLoader::databasePath()
+{
+    return QMail::dataPath() + QStringLiteral("database/qmailstore.db");
+}
+
+quint64 MessageLoader::load(const QMailMessageIdList &ids, const MessageFilter &filter)
+{
+    const quint64 serial = ++_lastSerial;
+
+    Request &request(_requests[serial]);
+    request.ids = ids;
+    request.filter = filter;
+    request.requested.start();
+
+    if (_threaded) {
+        QList<quint64> messageIds;
+        messageIds.reserve(ids.count());
+        for (const QMailMessageId &id : ids) {
+            messageIds.append(id.toULongLong());
+        }
+        emit loadRequested(serial, messageIds, filter);
+    } else {
+        // Keep results asynchronous, the caller handles them from the event loop
+        QMetaObject::invokeMethod(this, "loadFromStore", Qt::QueuedConnection, Q_ARG(quint64, serial));
+    }
+    return serial;
+}
+
+void MessageLoader::finishRequest(quint64 serial, const MessageInfoList &messages, const CountedMessages &counted)
+{
+    const Request request(_requests.take(serial));
+    const int chunks = (request.ids.count() + MaxIdsPerQuery - 1) / MaxIdsPerQuery;
+    Diagnostics::instance()->increment(Diagnostics::StoreQueries,
+                                       request.filter.countedAccounts.isEmpty() ? chunks : 2 * chunks);
+    Diagnostics::instance()->record(Diagnostics::MessageLoadTime, request.requested.nsecsElapsed() / 1000);
+    emit loaded(serial, messages, counted);
+}
+
+// ################ Slots #####################
+
+void MessageLoader::workerLoaded(quint64 serial, const MessageInfoList &messages, const CountedMessages &counted)
+{
+    finishRequest(serial, messages, counted);
+}
+
+void MessageLoader::workerFailed(quint64 serial)
+{
+    if (_threaded) {
+        qWarning() << Q_FUNC_INFO << "Loading messages from the main thread store";
+        _threaded = false;
+    }
+    loadFromStore(serial);
+}
+
+void MessageLoader::loadFromStore(quint64 serial)
+{
+    QHash<quint64, Request>::const_iterator it = _requests.constFind(serial);
+    if (it == _requests.constEnd()) {
+        return;
+    }
+
+    MessageInfoList messages;
+    CountedMessages counted;
+    const QMailMessageKey filter(it->filter.key());
+    for (int i = 0; i < it->ids.count(); i += MaxIdsPerQuery) {
+        const QMailMessageIdList chunk(it->ids.mid(i, MaxIdsPerQuery));
+        for (quint64 accountId : it->filter.countedAccounts) {
+            const QMailMessageIdList countedIds(QMailStore::instance()->queryMessages(
+                                                    QMailMessageKey::id(chunk) & it->filter.countKey(accountId)));
+            for (const QMailMessageId &id : countedIds) {
+                counted[accountId].append(id.toULongLong());
+            }
+        }
+        const QMailMessageMetaDataList metaData(QMailStore::instance()->messagesMetaData(
+                                                    QMailMessageKey::id(chunk) & filter, notificationProperties));
+        for (const QMailMessageMetaData &message : metaData) {
+            messages.append(constructMessageInfo(message.id(), message.parentAccountId(), message.from(),
+                                                 message.subject(), message.date().toUTC(),
+                                                 message.recipients().count(),
+                                                 message.parentThreadId().toULongLong(), message.rfcId()));
+        }
+    }
+    finishRequest(serial, messages, counted);
+}
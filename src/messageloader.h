@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2026 Jolla Ltd.
+ *
+ * This file is part of qmf-notifications-plugin
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+#ifndef MESSAGELOADER_H
+#define MESSAGELOADER_H
+
+// QMF
+#include <qmailmessage.h>
+#include <qmailmessagekey.h>
+
+// Qt
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QMetaType>
+#include <QObject>
+#include <QString>
+#include <QVector>
+
+class QThread;
+
+struct MessageInfo
+{
+    QMailMessageId id;
+    QString origin;
+    QString sender;
+    QString subject;
+    QDateTime timeStamp;
+    QMailAccountId accountId;
+    quint64 threadId = 0;
+    // Message-ID header, shared by the copies delivered to several accounts
+    QString rfcId;
+    bool hasMultipleRecipients = false;
+};
+
+typedef QVector<MessageInfo> MessageInfoList;
+// Matching messages of each counted account
+typedef QHash<quint64, QList<quint64> > CountedMessages;
+
+// Messages that can be notified: emails in the given folders without any of
+// the excluded status flags. Messages of the counted accounts are only counted.
+struct MessageFilter
+{
+    QList<quint64> folderIds;
+    quint64 excludedStatus = 0;
+    QList<quint64> countedAccounts;
+
+    QMailMessageKey key() const;
+    QMailMessageKey countKey(quint64 accountId) const;
+};
+
+Q_DECLARE_METATYPE(MessageInfoList)
+Q_DECLARE_METATYPE(CountedMessages)
+Q_DECLARE_METATYPE(MessageFilter)
+
+// Runs the loads in the worker thread, with its own read-only connection to
+// the mail store database
+class MessageLoaderWorker : public QObject
+{
+    Q_OBJECT
+public:
+    explicit MessageLoaderWorker(const QString &databasePath);
+    ~MessageLoaderWorker();
+
+public slots:
+    void load(quint64 serial, const QList<quint64> &ids, const MessageFilter &filter);
+
+signals:
+    void loaded(quint64 serial, const MessageInfoList &messages, const CountedMessages &counted);
+    void failed(quint64 serial);
+
+private:
+    bool open();
+
+    QString _databasePath;
+    QString _connectionName;
+    bool _opened;
+};
+
+// Loads the notification data of messages away from the main thread, the
+// message server protocol plugins share it. If the database can't be read
+// directly, or its schema is of an unknown version, the messages are loaded
+// from the main thread store instead.
+class MessageLoader : public QObject
+{
+    Q_OBJECT
+public:
+    explicit MessageLoader(QObject *parent = 0);
+    ~MessageLoader();
+
+    static QString databasePath();
+
+    // Returns the serial reported with the messages of ids matching filter
+    quint64 load(const QMailMessageIdList &ids, const MessageFilter &filter);
+
+signals:
+    void loaded(quint64 serial, const MessageInfoList &messages, const CountedMessages &counted);
+    void loadRequested(quint64 serial, const QList<quint64> &ids, const MessageFilter &filter);
+
+private slots:
+    void workerLoaded(quint64 serial, const MessageInfoList &messages, const CountedMessages &counted);
+    void workerFailed(quint64 serial);
+    void loadFromStore(quint64 serial);
+
+private:
+    struct Request
+    {
+        QMailMessageIdList ids;
+        MessageFilter filter;
+        QElapsedTimer requested;
+    };
+
+    void finishRequest(quint64 serial, const MessageInfoList &messages, const CountedMessages &counted);
+
+    QThread *_thread;
+    MessageLoaderWorker *_worker;
+    bool _threaded;
+    quint64 _lastSerial;
+    QHash<quint64, Request> _requests;
+};
+
+#endif // MESSAGELOADER_H
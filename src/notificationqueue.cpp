@@ -0,0 +1,332 @@
+/*
+ * Copyright (c) 2026 Jolla Ltd.
+ *
+ * This file is part of qmf-notifications-plugin
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+#include "notificationqueue.h"
+#include "diagnostics.h"
+
+// Qt
+#include <QDataStream>
+#include <QDateTime>
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QDBusPendingCallWatcher>
+#include <QDBusPendingReply>
+#include <QDebug>
+#include <QTimer>
+
+namespace {
+
+const auto notificationsService = QStringLiteral("org.freedesktop.Notifications");
+const auto notificationsPath = QStringLiteral("/org/freedesktop/Notifications");
+const auto notificationsInterface = QStringLiteral("org.freedesktop.Notifications");
+
+const auto remoteActionHint = QStringLiteral("x-nemo-remote-action-");
+const auto remoteActionIconHint = QStringLiteral("x-nemo-remote-action-icon-");
+
+// Maximum number of calls waiting for the daemon
+const int MaxPendingCalls = 8;
+
+// Encodes a remote action as Notification does: the service, path, interface
+// and method followed by each argument serialized in base64. Actions without
+// a call are only reported back with ActionInvoked.
+QString encodeRemoteAction(const QVariantMap &action)
+{
+    QStringList call;
+    call << action.value(QStringLiteral("service")).toString()
+         << action.value(QStringLiteral("path")).toString()
+         << action.value(QStringLiteral("iface")).toString()
+         << action.value(QStringLiteral("method")).toString();
+    if (call.contains(QString())) {
+        return QString();
+    }
+    for (const QVariant &argument : action.value(QStringLiteral("arguments")).toList()) {
+        QByteArray data;
+        QDataStream stream(&data, QIODevice::WriteOnly);
+        stream << argument;
+        call.append(QString::fromLatin1(data.toBase64()));
+    }
+    return call.join(QLatin1Char(' '));
+}
+
+}
+
+NotificationQueue::NotificationQueue(const QStringList &hints, QObject *parent)
+    : QObject(parent)
+    , _hints(hints)
+    , _pendingCalls(0)
+    , _scheduled(false)
+{
+}
+
+void NotificationQueue::publish(Notification *notification, const PublishCallback &published)
+{
+    Operation operation;
+    operation.notification = notification;
+    operation.closeId = 0;
+    operation.published = published;
+    _queue.enqueue(operation);
+    schedule();
+}
+
+void NotificationQueue::replace(Notification *existing, Notification *notification)
+{
+    notification->setReplacesId(existing->replacesId());
+    dequeue(existing);
+
+    // Without an id yet, the replacement is sent once existing gets it
+    if (Publication *pending = publication(existing)) {
+        pending->cancelled = true;
+        pending->replacement = notification;
+    } else if (Publication *pending = replacedPublication(existing)) {
+        pending->replacement = notification;
+    }
+}
+
+void NotificationQueue::close(Notification *notification)
+{
+    const bool publishing = publication(notification) || replacedPublication(notification);
+    cancel(notification);
+
+    // Notifications being published are closed once they get their id
+    if (!publishing && notification->replacesId() != 0) {
+        Operation operation;
+        operation.closeId = notification->replacesId();
+        _queue.enqueue(operation);
+        schedule();
+    }
+}
+
+void NotificationQueue::cancel(Notification *notification)
+{
+    dequeue(notification);
+
+    if (Publication *pending = publication(notification)) {
+        pending->cancelled = true;
+    }
+    if (Publication *pending = replacedPublication(notification)) {
+        pending->replacement = 0;
+    }
+}
+
+// Removes the queued operations of notification
+void NotificationQueue::dequeue(Notification *notification)
+{
+    QQueue<Operation>::iterator it = _queue.begin();
+    while (it != _queue.end()) {
+        if (it->notification == notification) {
+            it = _queue.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+NotificationQueue::Publication *NotificationQueue::publication(Notification *notification)
+{
+    for (Publication &pending : _publications) {
+        if (pending.notification == notification) {
+            return &pending;
+        }
+    }
+    return 0;
+}
+
+NotificationQueue::Publication *NotificationQueue::replacedPublication(Notification *replacement)
+{
+    for (Publication &pending : _publications) {
+        if (pending.replacement && pending.replacement == replacement) {
+            return &pending;
+        }
+    }
+    return 0;
+}
+
+void NotificationQueue::schedule()
+{
+    if (!_scheduled) {
+        _scheduled = true;
+        QTimer::singleShot(0, this, &NotificationQueue::processQueue);
+    }
+}
+
+// Continues once one of the pending calls has finished
+void NotificationQueue::processQueue()
+{
+    _scheduled = false;
+
+    while (!_queue.isEmpty() && _pendingCalls < MaxPendingCalls) {
+        if (!_queue.head().closeId && replacedPublication(_queue.head().notification.data())) {
+            // Waits for the id of the notification it replaces
+            return;
+        }
+
+        const Operation operation(_queue.dequeue());
+        if (operation.closeId) {
+            sendClose(operation.closeId);
+        } else if (operation.notification) {
+            sendPublish(operation);
+        }
+    }
+}
+
+void NotificationQueue::sendPublish(const Operation &operation)
+{
+    Notification *notification = operation.notification.data();
+
+    QStringList actions;
+    for (const QVariant &action : notification->remoteActions()) {
+        const QVariantMap remoteAction(action.toMap());
+        const QString name(remoteAction.value(QStringLiteral("name")).toString());
+        if (!name.isEmpty()) {
+            actions << name << remoteAction.value(QStringLiteral("displayName")).toString();
+        }
+    }
+
+    QDBusMessage message(QDBusMessage::createMethodCall(notificationsService, notificationsPath,
+                                                       notificationsInterface, QStringLiteral("Notify")));
+    message << notification->appName() << notification->replacesId() << notification->appIcon()
+            << notification->summary() << notification->body() << actions << hints(notification)
+            << notification->expireTimeout();
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(
+                QDBusConnection::sessionBus().asyncCall(message), this);
+    connect(watcher, &QDBusPendingCallWatcher::finished,
+            this, &NotificationQueue::publishFinished);
+
+    Publication pending;
+    pending.notification = notification;
+    pending.published = operation.published;
+    _publications.insert(watcher, pending);
+    ++_pendingCalls;
+    Diagnostics::instance()->increment(Diagnostics::NotificationCalls);
+    Diagnostics::instance()->increment(Diagnostics::NotificationsPublished);
+}
+
+void NotificationQueue::sendClose(uint id)
+{
+    QDBusMessage message(QDBusMessage::createMethodCall(notificationsService, notificationsPath,
+                                                       notificationsInterface, QStringLiteral("CloseNotification")));
+    message << id;
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(
+                QDBusConnection::sessionBus().asyncCall(message), this);
+    connect(watcher, &QDBusPendingCallWatcher::finished,
+            this, &NotificationQueue::closeFinished);
+    ++_pendingCalls;
+    Diagnostics::instance()->increment(Diagnostics::NotificationCalls);
+    Diagnostics::instance()->increment(Diagnostics::NotificationsClosed);
+}
+
+// Hints as Notification::publish() sends them, from the properties, the
+// remote actions and the named hints
+QVariantMap NotificationQueue::hints(Notification *notification) const
+{
+    QVariantMap hints;
+    for (const QString &hint : _hints) {
+        const QVariant value(notification->hintValue(hint));
+        if (value.isValid()) {
+            hints.insert(hint, value);
+        }
+    }
+
+    if (!notification->category().isEmpty()) {
+        hints.insert(QStringLiteral("category"), notification->category());
+    }
+    hints.insert(QStringLiteral("urgency"), static_cast<uchar>(notification->urgency()));
+    if (notification->isTransient()) {
+        hints.insert(QStringLiteral("transient"), true);
+    }
+    if (notification->itemCount() > 0) {
+        hints.insert(QStringLiteral("x-nemo-item-count"), notification->itemCount());
+    }
+    if (!notification->previewSummary().isEmpty()) {
+        hints.insert(QStringLiteral("x-nemo-preview-summary"), notification->previewSummary());
+    }
+    if (!notification->previewBody().isEmpty()) {
+        hints.insert(QStringLiteral("x-nemo-preview-body"), notification->previewBody());
+    }
+    const QDateTime timestamp(notification->timestamp());
+    hints.insert(QStringLiteral("x-nemo-timestamp"),
+                 (timestamp.isValid() ? timestamp : QDateTime::currentDateTimeUtc()).toString(Qt::ISODate));
+
+    for (const QVariant &action : notification->remoteActions()) {
+        const QVariantMap remoteAction(action.toMap());
+        const QString name(remoteAction.value(QStringLiteral("name")).toString());
+        if (name.isEmpty()) {
+            continue;
+        }
+        const QString call(encodeRemoteAction(remoteAction));
+        if (!call.isEmpty()) {
+            hints.insert(remoteActionHint + name, call);
+        }
+        const QString icon(remoteAction.value(QStringLiteral("icon")).toString());
+        if (!icon.isEmpty()) {
+            hints.insert(remoteActionIconHint + name, icon);
+        }
+    }
+    return hints;
+}
+
+void NotificationQueue::publishFinished(QDBusPendingCallWatcher *watcher)
+{
+    watcher->deleteLater();
+    --_pendingCalls;
+
+    const Publication pending(_publications.take(watcher));
+    const QDBusPendingReply<uint> reply(*watcher);
+    if (reply.isError()) {
+        qWarning() << Q_FUNC_INFO << "Cannot publish notification" << reply.error().message();
+    } else if (pending.replacement) {
+        pending.replacement->setReplacesId(reply.value());
+    } else if (pending.cancelled || !pending.notification) {
+        Operation operation;
+        operation.closeId = reply.value();
+        _queue.enqueue(operation);
+    } else {
+        pending.notification->setReplacesId(reply.value());
+        if (pending.published) {
+            pending.published(pending.notification.data());
+        }
+    }
+
+    if (!_queue.isEmpty()) {
+        schedule();
+    }
+}
+
+void NotificationQueue::closeFinished(QDBusPendingCallWatcher *watcher)
+{
+    watcher->deleteLater();
+    --_pendingCalls;
+    if (!_queue.isEmpty()) {
+        schedule();
+    }
+}
@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2026 Jolla Ltd.
+ *
+ * This file is part of qmf-notifications-plugin
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+#ifndef NOTIFICATIONQUEUE_H
+#define NOTIFICATIONQUEUE_H
+
+// nemonotifications-qt5
+#include <notification.h>
+
+// Qt
+#include <QHash>
+#include <QObject>
+#include <QPointer>
+#include <QQueue>
+#include <QStringList>
+#include <QVariantMap>
+
+#include <functional>
+
+class QDBusPendingCallWatcher;
+
+// Sends notification operations to the notification daemon from the event loop
+// as asynchronous calls, a bounded number at a time, so the message server
+// keeps handling store and action signals while the daemon is busy.
+class NotificationQueue : public QObject
+{
+    Q_OBJECT
+public:
+    typedef std::function<void (Notification *)> PublishCallback;
+
+    // Notification doesn't list its hints, the ones set with setHintValue()
+    // are sent if named in hints
+    explicit NotificationQueue(const QStringList &hints, QObject *parent = 0);
+
+    // The callback is invoked once the notification got its id from the daemon
+    void publish(Notification *notification, const PublishCallback &published = PublishCallback());
+    // Makes notification replace existing once published, existing is dropped
+    void replace(Notification *existing, Notification *notification);
+    // Drops a pending publication of notification, or closes it if it was already published
+    void close(Notification *notification);
+    void cancel(Notification *notification);
+
+private slots:
+    void processQueue();
+    void publishFinished(QDBusPendingCallWatcher *watcher);
+    void closeFinished(QDBusPendingCallWatcher *watcher);
+
+private:
+    struct Operation
+    {
+        QPointer<Notification> notification;
+        uint closeId;
+        PublishCallback published;
+    };
+
+    // Publication waiting for the daemon to return the notification id
+    struct Publication
+    {
+        QPointer<Notification> notification;
+        PublishCallback published;
+        // Dropped meanwhile, the notification is closed unless replaced
+        bool cancelled = false;
+        // Waits for the id to replace the notification
+        QPointer<Notification> replacement;
+    };
+
+    void schedule();
+    void sendPublish(const Operation &operation);
+    void sendClose(uint id);
+    QVariantMap hints(Notification *notification) const;
+    Publication *publication(Notification *notification);
+    Publication *replacedPublication(Notification *replacement);
+    void dequeue(Notification *notification);
+
+    QStringList _hints;
+    QQueue<Operation> _queue;
+    QHash<QDBusPendingCallWatcher *, Publication> _publications;
+    int _pendingCalls;
+    bool _scheduled;
+};
+
+#endif // NOTIFICATIONQUEUE_H
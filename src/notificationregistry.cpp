@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2026 Jolla Ltd.
+ *
+ * This file is part of qmf-notifications-plugin
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+#include "notificationregistry.h"
+
+void NotificationRegistry::insert(Notification *notification, Kind kind, const QMailAccountId &accountId,
+                                  const QMailMessageId &messageId, const QString &groupKey)
+{
+    remove(notification);
+
+    Entry entry;
+    entry.kind = kind;
+    entry.accountId = accountId;
+    entry.messageId = messageId;
+    entry.groupKey = groupKey;
+    _entries.insert(notification, entry);
+
+    if (kind == MessageNotification && messageId.isValid()) {
+        _messageNotifications.insert(messageId, notification);
+    } else if (kind == GroupNotification) {
+        _groupNotifications.insert(groupKey, notification);
+    } else if (kind == SendFailedNotification && accountId.isValid()) {
+        _sendFailedNotifications.insert(accountId, notification);
+    }
+    if (accountId.isValid()) {
+        _accountNotifications.insert(accountId, notification);
+    }
+}
+
+void NotificationRegistry::remove(Notification *notification)
+{
+    QHash<Notification *, Entry>::iterator it = _entries.find(notification);
+    if (it == _entries.end()) {
+        return;
+    }
+
+    const Entry &entry(it.value());
+    if (entry.kind == MessageNotification && _messageNotifications.value(entry.messageId) == notification) {
+        _messageNotifications.remove(entry.messageId);
+    } else if (entry.kind == GroupNotification && _groupNotifications.value(entry.groupKey) == notification) {
+        _groupNotifications.remove(entry.groupKey);
+    } else if (entry.kind == SendFailedNotification
+               && _sendFailedNotifications.value(entry.accountId) == notification) {
+        _sendFailedNotifications.remove(entry.accountId);
+    }
+    if (entry.accountId.isValid()) {
+        _accountNotifications.remove(entry.accountId, notification);
+    }
+    _entries.erase(it);
+}
+
+void NotificationRegistry::clear()
+{
+    _entries.clear();
+    _messageNotifications.clear();
+    _groupNotifications.clear();
+    _sendFailedNotifications.clear();
+    _accountNotifications.clear();
+}
+
+bool NotificationRegistry::contains(Notification *notification) const
+{
+    return _entries.contains(notification);
+}
+
+NotificationRegistry::Entry NotificationRegistry::entry(Notification *notification) const
+{
+    return _entries.value(notification);
+}
+
+Notification *NotificationRegistry::messageNotification(const QMailMessageId &messageId) const
+{
+    return _messageNotifications.value(messageId);
+}
+
+Notification *NotificationRegistry::groupNotification(const QString &groupKey) const
+{
+    return _groupNotifications.value(groupKey);
+}
+
+Notification *NotificationRegistry::sendFailedNotification(const QMailAccountId &accountId) const
+{
+    return _sendFailedNotifications.value(accountId);
+}
+
+QList<QMailMessageId> NotificationRegistry::messageIds() const
+{
+    return _messageNotifications.keys();
+}
+
+QList<Notification *> NotificationRegistry::accountNotifications(const QMailAccountId &accountId) const
+{
+    return _accountNotifications.values(accountId);
+}
+
+QList<Notification *> NotificationRegistry::notifications() const
+{
+    return _entries.keys();
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2026 Jolla Ltd.
+ *
+ * This file is part of qmf-notifications-plugin
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+#ifndef NOTIFICATIONREGISTRY_H
+#define NOTIFICATIONREGISTRY_H
+
+// nemonotifications-qt5
+#include <notification.h>
+
+// QMF
+#include <qmailmessage.h>
+
+// Qt
+#include <QHash>
+#include <QList>
+#include <QString>
+
+// Keeps track of the notifications published by the plugin, so that
+// the notification daemon only needs to be queried on startup or resync.
+class NotificationRegistry
+{
+public:
+    enum Kind {
+        MessageNotification,
+        SummaryNotification,
+        SendFailedNotification,
+        // Summary of the messages added by the first sync of an account
+        FirstSyncNotification,
+        // Messages of a conversation, or of a sender
+        GroupNotification
+    };
+
+    struct Entry
+    {
+        Kind kind = MessageNotification;
+        QMailAccountId accountId;
+        QMailMessageId messageId;
+        QString groupKey;
+    };
+
+    void insert(Notification *notification, Kind kind, const QMailAccountId &accountId,
+                const QMailMessageId &messageId = QMailMessageId(), const QString &groupKey = QString());
+    void remove(Notification *notification);
+    void clear();
+
+    bool contains(Notification *notification) const;
+    Entry entry(Notification *notification) const;
+
+    Notification *messageNotification(const QMailMessageId &messageId) const;
+    Notification *groupNotification(const QString &groupKey) const;
+    Notification *sendFailedNotification(const QMailAccountId &accountId) const;
+    QList<QMailMessageId> messageIds() const;
+    QList<Notification *> accountNotifications(const QMailAccountId &accountId) const;
+    QList<Notification *> notifications() const;
+
+private:
+    QHash<Notification *, Entry> _entries;
+    QHash<QMailMessageId, Notification *> _messageNotifications;
+    QHash<QString, Notification *> _groupNotifications;
+    QHash<QMailAccountId, Notification *> _sendFailedNotifications;
+    QMultiHash<QMailAccountId, Notification *> _accountNotifications;
+};
+
+#endif // NOTIFICATIONREGISTRY_H
@@ -33,15 +33,24 @@
  */
 
 #include "notificationsplugin.h"
+#include "diagnostics.h"
 
 // Qt
 #include <QCoreApplication>
+#include <QDBusConnection>
 #include <QTranslator>
 #include <QDebug>
 
+namespace {
+
+const auto diagnosticsPath = QStringLiteral("/org/sailfishos/qmf/notifications");
+
+}
+
 NotificationsService::NotificationsService()
     : QMailMessageServerService()
-    , _actionObserver(new ActionObserver(this))
+    , _accountCache(new AccountCache(this))
+    , _actionObserver(new ActionObserver(_accountCache, this))
 {
     QString translationPath("/usr/share/translations/");
     QTranslator *engineeringEnglish = new QTranslator(this);
@@ -53,13 +62,16 @@ NotificationsService::NotificationsService()
     QCoreApplication::instance()->installTranslator(translator);
 
     // Initiate after the translator since it will use it
-    _mailStoreObserver = new MailStoreObserver(this);
+    _mailStoreObserver = new MailStoreObserver(_accountCache, this);
 
     // Connect actions observer to mail store observer
     // to report when all actions are completed and
     // only then emit notifications.
     connect(_actionObserver, &ActionObserver::actionsCompleted,
             _mailStoreObserver, &MailStoreObserver::publishChanges);
+    // Accounts whose actions are done don't wait for the others
+    connect(_actionObserver, &ActionObserver::accountActionsCompleted,
+            _mailStoreObserver, &MailStoreObserver::publishAccountChanges);
     connect(_actionObserver, &ActionObserver::transmitCompleted,
             _mailStoreObserver, &MailStoreObserver::transmitCompleted);
     connect(_actionObserver, &ActionObserver::transmitFailed,
@@ -70,11 +82,18 @@ NotificationsService::NotificationsService()
                     _mailStoreObserver->publishChanges();
                 }
             });
+
+    if (!QDBusConnection::sessionBus().registerObject(diagnosticsPath, Diagnostics::instance(),
+                                                      QDBusConnection::ExportScriptableSlots)) {
+        qWarning() << "Failed to register diagnostics object" << diagnosticsPath;
+    }
+
     qDebug() << "Initiating mail notifications plugin";
 }
 
 NotificationsService::~NotificationsService()
 {
+    QDBusConnection::sessionBus().unregisterObject(diagnosticsPath);
 }
 
 NotificationsPlugin::NotificationsPlugin(QObject *parent)
@@ -35,6 +35,7 @@
 #ifndef NOTIFICATIONSPLUGIN_H
 #define NOTIFICATIONSPLUGIN_H
 
+#include "accountcache.h"
 #include "actionobserver.h"
 #include "mailstoreobserver.h"
 
@@ -54,6 +55,7 @@ public:
     ~NotificationsService();
 
 private:
+    AccountCache *_accountCache;
     ActionObserver *_actionObserver;
     MailStoreObserver *_mailStoreObserver;
 };
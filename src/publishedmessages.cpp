@@ -0,0 +1,239 @@
+/*
+ * Copyright (c) 2026 Jolla Ltd.
+ *
+ * This file is part of qmf-notifications-plugin
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+#include "publishedmessages.h"
+
+void PublishedMessages::insert(const MessageInfo &message, bool isNew)
+{
+    const quint64 id = message.id.toULongLong();
+    remove(message.id);
+
+    quint32 slot;
+    if (!_freeSlots.isEmpty()) {
+        slot = _freeSlots.takeLast();
+    } else {
+        slot = static_cast<quint32>(_entries.count());
+        _entries.append(Entry());
+    }
+
+    Entry &entry(_entries[slot]);
+    entry.id = id;
+    entry.accountId = message.accountId.toULongLong();
+    entry.threadId = message.threadId;
+    entry.timeStamp = message.timeStamp.toMSecsSinceEpoch();
+    entry.subject = message.subject;
+    entry.rfcId = message.rfcId;
+    entry.origin = intern(message.origin);
+    entry.sender = intern(message.sender);
+    entry.flags &= ListedFlag;
+    if (message.hasMultipleRecipients) {
+        entry.flags |= MultipleRecipientsFlag;
+    }
+    if (isNew) {
+        entry.flags |= NewFlag;
+        ++_newCount;
+        if (!(entry.flags & ListedFlag)) {
+            entry.flags |= ListedFlag;
+            _newSlots.append(slot);
+        }
+    }
+
+    _index.insert(id, slot);
+    _accountMessages[entry.accountId].insert(entry.timeStamp, id);
+}
+
+bool PublishedMessages::remove(const QMailMessageId &id)
+{
+    QHash<quint64, quint32>::iterator it = _index.find(id.toULongLong());
+    if (it == _index.end()) {
+        return false;
+    }
+
+    const quint32 slot = it.value();
+    _index.erase(it);
+
+    Entry &entry(_entries[slot]);
+    QHash<quint64, QMultiMap<qint64, quint64> >::iterator accountIt = _accountMessages.find(entry.accountId);
+    if (accountIt != _accountMessages.end()) {
+        accountIt->remove(entry.timeStamp, entry.id);
+        if (accountIt->isEmpty()) {
+            _accountMessages.erase(accountIt);
+        }
+    }
+
+    if (entry.flags & NewFlag) {
+        --_newCount;
+    }
+    release(entry.origin);
+    release(entry.sender);
+
+    // The slot may still be listed as new, it is skipped there once free
+    const quint8 listed = entry.flags & ListedFlag;
+    entry = Entry();
+    entry.flags = listed;
+    _freeSlots.append(slot);
+    return true;
+}
+
+void PublishedMessages::clear()
+{
+    _entries.clear();
+    _freeSlots.clear();
+    _index.clear();
+    _newSlots.clear();
+    _newCount = 0;
+    _accountMessages.clear();
+    _strings.clear();
+    _freeStrings.clear();
+    _stringIndex.clear();
+}
+
+bool PublishedMessages::contains(const QMailMessageId &id) const
+{
+    return _index.contains(id.toULongLong());
+}
+
+bool PublishedMessages::isNew(const QMailMessageId &id) const
+{
+    QHash<quint64, quint32>::const_iterator it = _index.constFind(id.toULongLong());
+    return it != _index.constEnd() && (_entries.at(it.value()).flags & NewFlag);
+}
+
+int PublishedMessages::count() const
+{
+    return _index.count();
+}
+
+MessageInfo PublishedMessages::message(const QMailMessageId &id) const
+{
+    QHash<quint64, quint32>::const_iterator it = _index.constFind(id.toULongLong());
+    return it != _index.constEnd() ? messageInfo(_entries.at(it.value())) : MessageInfo();
+}
+
+QVector<MessageInfo> PublishedMessages::messages() const
+{
+    QVector<MessageInfo> messages;
+    messages.reserve(_index.count());
+    for (quint32 slot : _index) {
+        messages.append(messageInfo(_entries.at(slot)));
+    }
+    return messages;
+}
+
+QMailAccountId PublishedMessages::accountId(const QMailMessageId &id) const
+{
+    QHash<quint64, quint32>::const_iterator it = _index.constFind(id.toULongLong());
+    return it != _index.constEnd() ? QMailAccountId(_entries.at(it.value()).accountId) : QMailAccountId();
+}
+
+int PublishedMessages::accountCount(const QMailAccountId &accountId) const
+{
+    return _accountMessages.value(accountId.toULongLong()).count();
+}
+
+QMailMessageId PublishedMessages::earliestMessage(const QMailAccountId &accountId) const
+{
+    QHash<quint64, QMultiMap<qint64, quint64> >::const_iterator it = _accountMessages.constFind(accountId.toULongLong());
+    return it != _accountMessages.constEnd() && !it->isEmpty() ? QMailMessageId(it->first()) : QMailMessageId();
+}
+
+bool PublishedMessages::hasNewMessages() const
+{
+    return _newCount > 0;
+}
+
+QVector<MessageInfo> PublishedMessages::takeNewMessages(const QMailAccountId &accountId)
+{
+    QVector<MessageInfo> messages;
+    QVector<quint32> remaining;
+    for (quint32 slot : _newSlots) {
+        Entry &entry(_entries[slot]);
+        if (!(entry.flags & NewFlag)) {
+            entry.flags &= ~ListedFlag;
+        } else if (accountId.isValid() && entry.accountId != accountId.toULongLong()) {
+            remaining.append(slot);
+        } else {
+            messages.append(messageInfo(entry));
+            entry.flags &= ~(NewFlag | ListedFlag);
+            --_newCount;
+        }
+    }
+    _newSlots = remaining;
+    return messages;
+}
+
+quint32 PublishedMessages::intern(const QString &value)
+{
+    QHash<QString, quint32>::const_iterator it = _stringIndex.constFind(value);
+    if (it != _stringIndex.constEnd()) {
+        ++_strings[it.value()].references;
+        return it.value();
+    }
+
+    quint32 index;
+    if (!_freeStrings.isEmpty()) {
+        index = _freeStrings.takeLast();
+    } else {
+        index = static_cast<quint32>(_strings.count());
+        _strings.append(InternedString());
+    }
+    _strings[index].value = value;
+    _strings[index].references = 1;
+    _stringIndex.insert(value, index);
+    return index;
+}
+
+void PublishedMessages::release(quint32 index)
+{
+    InternedString &string(_strings[index]);
+    if (--string.references == 0) {
+        _stringIndex.remove(string.value);
+        string.value.clear();
+        _freeStrings.append(index);
+    }
+}
+
+MessageInfo PublishedMessages::messageInfo(const Entry &entry) const
+{
+    MessageInfo message;
+    message.id = QMailMessageId(entry.id);
+    message.origin = _strings.at(entry.origin).value;
+    message.sender = _strings.at(entry.sender).value;
+    message.subject = entry.subject;
+    message.rfcId = entry.rfcId;
+    message.timeStamp = QDateTime::fromMSecsSinceEpoch(entry.timeStamp, Qt::UTC);
+    message.accountId = QMailAccountId(entry.accountId);
+    message.threadId = entry.threadId;
+    message.hasMultipleRecipients = entry.flags & MultipleRecipientsFlag;
+    return message;
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2026 Jolla Ltd.
+ *
+ * This file is part of qmf-notifications-plugin
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+#ifndef PUBLISHEDMESSAGES_H
+#define PUBLISHEDMESSAGES_H
+
+#include "messageloader.h"
+
+// Qt
+#include <QHash>
+#include <QMap>
+#include <QString>
+#include <QVector>
+
+// Messages the plugin has notifications published for. Entries are kept in a
+// contiguous pool indexed by message id, with sender names and addresses
+// shared between the messages of the same senders.
+class PublishedMessages
+{
+public:
+    void insert(const MessageInfo &message, bool isNew);
+    bool remove(const QMailMessageId &id);
+    void clear();
+
+    bool contains(const QMailMessageId &id) const;
+    // Not taken by takeNewMessages() yet
+    bool isNew(const QMailMessageId &id) const;
+    int count() const;
+    MessageInfo message(const QMailMessageId &id) const;
+    QVector<MessageInfo> messages() const;
+    QMailAccountId accountId(const QMailMessageId &id) const;
+
+    int accountCount(const QMailAccountId &accountId) const;
+    // Message of the account with the earliest time stamp
+    QMailMessageId earliestMessage(const QMailAccountId &accountId) const;
+
+    bool hasNewMessages() const;
+    // Returns the new messages of the account, or of all accounts if accountId
+    // is invalid, in insertion order and marks them as no longer new
+    QVector<MessageInfo> takeNewMessages(const QMailAccountId &accountId = QMailAccountId());
+
+private:
+    enum Flag {
+        NewFlag = 0x1,
+        MultipleRecipientsFlag = 0x2,
+        // The slot is listed in _newSlots
+        ListedFlag = 0x4
+    };
+
+    struct Entry
+    {
+        quint64 id = 0;
+        quint64 accountId = 0;
+        quint64 threadId = 0;
+        qint64 timeStamp = 0;
+        QString subject;
+        // Message-ID header, matched against later copies of the message
+        QString rfcId;
+        quint32 origin = 0;
+        quint32 sender = 0;
+        quint8 flags = 0;
+    };
+
+    struct InternedString
+    {
+        QString value;
+        quint32 references = 0;
+    };
+
+    quint32 intern(const QString &value);
+    void release(quint32 index);
+    MessageInfo messageInfo(const Entry &entry) const;
+
+    QVector<Entry> _entries;
+    QVector<quint32> _freeSlots;
+    QHash<quint64, quint32> _index;
+    QVector<quint32> _newSlots;
+    int _newCount = 0;
+    // Messages of each account ordered by time stamp
+    QHash<quint64, QMultiMap<qint64, quint64> > _accountMessages;
+
+    QVector<InternedString> _strings;
+    QVector<quint32> _freeStrings;
+    QHash<QString, quint32> _stringIndex;
+};
+
+#endif // PUBLISHEDMESSAGES_H
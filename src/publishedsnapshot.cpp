@@ -0,0 +1,278 @@
+/*
+ * Copyright (c) 2026 Jolla Ltd.
+ *
+ * This file is part of qmf-notifications-plugin
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+#include "publishedsnapshot.h"
+
+// Qt
+#include <QByteArray>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QHash>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+const quint32 SnapshotMagic = 0x514e5053; // "SPNQ"
+const quint32 SnapshotVersion = 4;
+
+const quint32 MultipleRecipientsFlag = 0x1;
+
+// Fixed-size layout, records are sorted by message id and strings are
+// offsets into the blob following them: a length in UTF-16 units, then
+// the characters padded to four bytes
+struct SnapshotHeader
+{
+    quint32 magic;
+    quint32 version;
+    quint32 recordCount;
+    quint32 stringsSize;
+};
+
+struct SnapshotRecord
+{
+    quint64 messageId;
+    quint64 accountId;
+    quint64 threadId;
+    qint64 timeStamp;
+    quint32 notificationId;
+    quint32 flags;
+    quint32 origin;
+    quint32 sender;
+    quint32 subject;
+    quint32 rfcId;
+};
+
+QString snapshotPath()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation)
+            + QStringLiteral("/qmf-notifications/published.snapshot");
+}
+
+quint32 appendString(QByteArray *strings, QHash<QString, quint32> *offsets, const QString &value)
+{
+    QHash<QString, quint32>::const_iterator it = offsets->constFind(value);
+    if (it != offsets->constEnd()) {
+        return it.value();
+    }
+
+    const quint32 offset = static_cast<quint32>(strings->size());
+    const quint32 length = static_cast<quint32>(value.size());
+    strings->append(reinterpret_cast<const char *>(&length), sizeof(length));
+    strings->append(reinterpret_cast<const char *>(value.utf16()), value.size() * sizeof(ushort));
+    while (strings->size() % 4) {
+        strings->append('\0');
+    }
+    offsets->insert(value, offset);
+    return offset;
+}
+
+}
+
+PublishedSnapshot::PublishedSnapshot()
+    : _file(snapshotPath())
+    , _data(0)
+    , _size(0)
+    , _recordCount(0)
+    , _stringsSize(0)
+{
+}
+
+PublishedSnapshot::~PublishedSnapshot()
+{
+    close();
+}
+
+bool PublishedSnapshot::write(QVector<Record> records)
+{
+    std::sort(records.begin(), records.end(), [](const Record &a, const Record &b) {
+        return a.message.id.toULongLong() < b.message.id.toULongLong();
+    });
+
+    QByteArray strings;
+    QHash<QString, quint32> offsets;
+    QVector<SnapshotRecord> snapshotRecords;
+    snapshotRecords.reserve(records.count());
+    for (const Record &record : records) {
+        SnapshotRecord snapshotRecord;
+        snapshotRecord.messageId = record.message.id.toULongLong();
+        snapshotRecord.accountId = record.message.accountId.toULongLong();
+        snapshotRecord.threadId = record.message.threadId;
+        snapshotRecord.timeStamp = record.message.timeStamp.toMSecsSinceEpoch();
+        snapshotRecord.notificationId = record.notificationId;
+        snapshotRecord.flags = record.message.hasMultipleRecipients ? MultipleRecipientsFlag : 0;
+        snapshotRecord.origin = appendString(&strings, &offsets, record.message.origin);
+        snapshotRecord.sender = appendString(&strings, &offsets, record.message.sender);
+        snapshotRecord.subject = appendString(&strings, &offsets, record.message.subject);
+        snapshotRecord.rfcId = appendString(&strings, &offsets, record.message.rfcId);
+        snapshotRecords.append(snapshotRecord);
+    }
+
+    SnapshotHeader header;
+    header.magic = SnapshotMagic;
+    header.version = SnapshotVersion;
+    header.recordCount = static_cast<quint32>(snapshotRecords.count());
+    header.stringsSize = static_cast<quint32>(strings.size());
+
+    const QString path(snapshotPath());
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << Q_FUNC_INFO << "Cannot write" << path << file.errorString();
+        return false;
+    }
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(snapshotRecords.constData()),
+               snapshotRecords.count() * sizeof(SnapshotRecord));
+    file.write(strings);
+    return file.commit();
+}
+
+void PublishedSnapshot::remove()
+{
+    QFile::remove(snapshotPath());
+}
+
+bool PublishedSnapshot::open()
+{
+    close();
+    if (!_file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    _size = _file.size();
+    if (_size < static_cast<qint64>(sizeof(SnapshotHeader))
+            || !(_data = _file.map(0, _size))) {
+        close();
+        return false;
+    }
+
+    const SnapshotHeader *header = reinterpret_cast<const SnapshotHeader *>(_data);
+    const qint64 expectedSize = sizeof(SnapshotHeader)
+            + static_cast<qint64>(header->recordCount) * sizeof(SnapshotRecord) + header->stringsSize;
+    if (header->magic != SnapshotMagic || header->version != SnapshotVersion || expectedSize != _size) {
+        qWarning() << Q_FUNC_INFO << "Ignoring invalid snapshot" << _file.fileName();
+        close();
+        return false;
+    }
+
+    _recordCount = header->recordCount;
+    _stringsSize = header->stringsSize;
+    return true;
+}
+
+void PublishedSnapshot::close()
+{
+    if (_data) {
+        _file.unmap(const_cast<uchar *>(_data));
+        _data = 0;
+    }
+    _file.close();
+    _size = 0;
+    _recordCount = 0;
+    _stringsSize = 0;
+}
+
+bool PublishedSnapshot::find(const QMailMessageId &id, Record *record) const
+{
+    if (!_data) {
+        return false;
+    }
+
+    const SnapshotRecord *begin = reinterpret_cast<const SnapshotRecord *>(_data + sizeof(SnapshotHeader));
+    const SnapshotRecord *end = begin + _recordCount;
+    const quint64 messageId = id.toULongLong();
+    const SnapshotRecord *it = std::lower_bound(begin, end, messageId,
+                                                [](const SnapshotRecord &r, quint64 value) {
+        return r.messageId < value;
+    });
+    if (it == end || it->messageId != messageId) {
+        return false;
+    }
+
+    *record = readRecord(static_cast<quint32>(it - begin));
+    return true;
+}
+
+// Records sharing a notification, a grouped notification shows several messages
+QVector<PublishedSnapshot::Record> PublishedSnapshot::notificationRecords(uint notificationId) const
+{
+    QVector<Record> records;
+    if (!_data || !notificationId) {
+        return records;
+    }
+
+    const SnapshotRecord *snapshotRecords = reinterpret_cast<const SnapshotRecord *>(_data + sizeof(SnapshotHeader));
+    for (quint32 i = 0; i < _recordCount; ++i) {
+        if (snapshotRecords[i].notificationId == notificationId) {
+            records.append(readRecord(i));
+        }
+    }
+    return records;
+}
+
+PublishedSnapshot::Record PublishedSnapshot::readRecord(quint32 index) const
+{
+    const SnapshotRecord *snapshotRecord = reinterpret_cast<const SnapshotRecord *>(_data + sizeof(SnapshotHeader)) + index;
+    Record record;
+    record.message.id = QMailMessageId(snapshotRecord->messageId);
+    record.message.accountId = QMailAccountId(snapshotRecord->accountId);
+    record.message.threadId = snapshotRecord->threadId;
+    record.message.timeStamp = QDateTime::fromMSecsSinceEpoch(snapshotRecord->timeStamp, Qt::UTC);
+    record.message.hasMultipleRecipients = snapshotRecord->flags & MultipleRecipientsFlag;
+    record.message.origin = string(snapshotRecord->origin);
+    record.message.sender = string(snapshotRecord->sender);
+    record.message.subject = string(snapshotRecord->subject);
+    record.message.rfcId = string(snapshotRecord->rfcId);
+    record.notificationId = snapshotRecord->notificationId;
+    return record;
+}
+
+QString PublishedSnapshot::string(quint32 offset) const
+{
+    const uchar *strings = _data + sizeof(SnapshotHeader) + _recordCount * sizeof(SnapshotRecord);
+    if (static_cast<quint64>(offset) + sizeof(quint32) > _stringsSize) {
+        return QString();
+    }
+
+    quint32 length;
+    memcpy(&length, strings + offset, sizeof(length));
+    if (static_cast<quint64>(offset) + sizeof(quint32) + static_cast<quint64>(length) * sizeof(ushort) > _stringsSize) {
+        return QString();
+    }
+    return QString(reinterpret_cast<const QChar *>(strings + offset + sizeof(quint32)), static_cast<int>(length));
+}
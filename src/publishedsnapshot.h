@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2026 Jolla Ltd.
+ *
+ * This file is part of qmf-notifications-plugin
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+#ifndef PUBLISHEDSNAPSHOT_H
+#define PUBLISHEDSNAPSHOT_H
+
+#include "messageloader.h"
+
+// Qt
+#include <QFile>
+#include <QString>
+#include <QVector>
+
+// On-disk copy of the published messages and their notification ids, written
+// while the message server runs and mapped into memory on the next start.
+// The store can change while the message server is down, so the records
+// are checked against it before they are used.
+class PublishedSnapshot
+{
+public:
+    struct Record
+    {
+        MessageInfo message;
+        uint notificationId = 0;
+    };
+
+    PublishedSnapshot();
+    ~PublishedSnapshot();
+
+    static bool write(QVector<Record> records);
+    static void remove();
+
+    bool open();
+    void close();
+    bool find(const QMailMessageId &id, Record *record) const;
+    QVector<Record> notificationRecords(uint notificationId) const;
+
+private:
+    Record readRecord(quint32 index) const;
+    QString string(quint32 offset) const;
+
+    QFile _file;
+    const uchar *_data;
+    qint64 _size;
+    quint32 _recordCount;
+    quint32 _stringsSize;
+};
+
+#endif // PUBLISHEDSNAPSHOT_H
@@ -3,19 +3,36 @@ TARGET = notifications
 CONFIG += plugin hide_symbols
 
 QT -= gui
+QT += dbus sql
 
 CONFIG += link_pkgconfig
 PKGCONFIG += nemotransferengine-qt5 nemonotifications-qt5 nemoemail-qt5 QmfClient QmfMessageServer
 
 SOURCES += \
+    accountcache.cpp \
     actionobserver.cpp \
+    diagnostics.cpp \
     notificationsplugin.cpp \
-    mailstoreobserver.cpp
+    mailstoreobserver.cpp \
+    messageloader.cpp \
+    notificationqueue.cpp \
+    notificationregistry.cpp \
+    publishedmessages.cpp \
+    publishedsnapshot.cpp \
+    syncevents.cpp
 
 HEADERS += \
+    accountcache.h \
     actionobserver.h \
+    diagnostics.h \
     notificationsplugin.h \
-    mailstoreobserver.h
+    mailstoreobserver.h \
+    messageloader.h \
+    notificationqueue.h \
+    notificationregistry.h \
+    publishedmessages.h \
+    publishedsnapshot.h \
+    syncevents.h
 
 OTHER_FILES += \
     rpm/qmf-notifications-plugin.spec
@@ -0,0 +1,294 @@
+/*
+ * Copyright (c) 2026 Jolla Ltd.
+ *
+ * This file is part of qmf-notifications-plugin
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+#include "syncevents.h"
+#include "accountcache.h"
+#include "diagnostics.h"
+
+// nemotransferengine-qt5
+#include <transferenginedata.h>
+
+// Qt
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QDBusPendingCallWatcher>
+#include <QDBusPendingReply>
+#include <QDebug>
+#include <QSet>
+#include <QTimer>
+#include <QUrl>
+
+namespace {
+
+// Selects how sync actions are grouped into transfer-ui events:
+// "account" for one event per account, "all" for a single event.
+const char *const aggregationVariable = "QMF_NOTIFICATIONS_SYNC_EVENTS";
+
+// Key of the event shared by all accounts
+const quint64 GlobalEventKey = 0;
+
+const auto transferEngineService = QStringLiteral("org.nemo.transferengine");
+const auto transferEnginePath = QStringLiteral("/org/nemo/transferengine");
+const auto transferEngineInterface = QStringLiteral("org.nemo.transferengine");
+
+// Progress is reported at most once per interval and only when it has
+// moved enough, unless nothing has been reported for a long time
+const int MinProgressInterval = 500;
+const qreal MinProgressDelta = 0.02;
+const int MaxProgressSilence = 5000;
+
+SyncEvents::Aggregation aggregationFromEnvironment()
+{
+    const QByteArray value(qgetenv(aggregationVariable).toLower());
+    if (value == "account") {
+        return SyncEvents::AccountAggregation;
+    } else if (value == "all") {
+        return SyncEvents::GlobalAggregation;
+    } else if (!value.isEmpty() && value != "none") {
+        qWarning() << "Unknown" << aggregationVariable << "value" << value << ", sync events are not aggregated";
+    }
+    return SyncEvents::NoAggregation;
+}
+
+}
+
+SyncEvents::SyncEvents(AccountCache *accounts, QObject *parent)
+    : QObject(parent)
+    , _aggregation(aggregationFromEnvironment())
+    , _accounts(accounts)
+    , _transferClient(new TransferEngineClient(this))
+    , _progressTimer(new QTimer(this))
+{
+    _progressTimer->setSingleShot(true);
+    connect(_progressTimer, &QTimer::timeout,
+            this, &SyncEvents::flushProgress);
+
+    Diagnostics *diagnostics = Diagnostics::instance();
+    diagnostics->setValue(QStringLiteral("syncProgressMinIntervalMs"), MinProgressInterval);
+    diagnostics->setValue(QStringLiteral("syncProgressMinDelta"), MinProgressDelta);
+    diagnostics->setValue(QStringLiteral("syncProgressMaxSilenceMs"), MaxProgressSilence);
+}
+
+SyncEvents::~SyncEvents()
+{
+    QSet<Event *> events;
+    for (Event *event : _actionEvents) {
+        events.insert(event);
+    }
+    qDeleteAll(events);
+}
+
+SyncEvents::Aggregation SyncEvents::aggregation() const
+{
+    return _aggregation;
+}
+
+void SyncEvents::actionStarted(quint64 actionId, const QMailAccountId &accountId)
+{
+    if (_actionEvents.contains(actionId)) {
+        qWarning() << Q_FUNC_INFO << "This action is already running in the transfer engine!";
+        return;
+    }
+
+    Event *event = 0;
+    if (_aggregation == NoAggregation) {
+        event = createEvent(accountId);
+    } else {
+        const quint64 key = _aggregation == AccountAggregation ? accountId.toULongLong() : GlobalEventKey;
+        event = _sharedEvents.value(key);
+        if (!event) {
+            event = createEvent(accountId);
+            if (event) {
+                event->key = key;
+                _sharedEvents.insert(key, event);
+            }
+        }
+    }
+
+    if (event) {
+        event->actions.insert(actionId, 0.0);
+        _actionEvents.insert(actionId, event);
+        updateProgress(event);
+    }
+}
+
+void SyncEvents::actionProgress(quint64 actionId, qreal progress)
+{
+    Event *event = _actionEvents.value(actionId);
+    if (event) {
+        event->actions[actionId] = progress;
+        updateProgress(event);
+    }
+}
+
+void SyncEvents::actionFinished(quint64 actionId, bool successful)
+{
+    Event *event = _actionEvents.take(actionId);
+    if (!event) {
+        return;
+    }
+
+    event->actions.remove(actionId);
+    event->failed = event->failed || !successful;
+    if (event->actions.isEmpty()) {
+        finishEvent(event);
+    } else {
+        // The finished action counts as complete, flush it right away
+        ++event->finished;
+        updateProgress(event, true);
+    }
+}
+
+SyncEvents::Event *SyncEvents::createEvent(const QMailAccountId &accountId)
+{
+    QString name;
+    QUrl icon;
+    if (_aggregation == GlobalAggregation) {
+        //% "Mail"
+        name = qtTrId("qmf-notification_mail");
+    } else {
+        name = _accounts->name(accountId);
+        icon = QUrl(_accounts->iconPath(accountId));
+    }
+
+    // The event id is needed for the following calls, this one is synchronous
+    int transferId = 0;
+    {
+        DiagnosticsTimer timer(Diagnostics::TransferEngineTime);
+        Diagnostics::instance()->increment(Diagnostics::TransferEngineCalls);
+        transferId = _transferClient->createSyncEvent(name, QUrl(), icon);
+    }
+    if (!transferId) {
+        qWarning() << Q_FUNC_INFO << "Failed to create sync event in transfer engine!";
+        return 0;
+    }
+
+    callTransferEngine(QStringLiteral("startTransfer"), QVariantList() << transferId);
+
+    Event *event = new Event;
+    event->transferId = transferId;
+    event->lastUpdate.start();
+    return event;
+}
+
+// Reports the mean progress of the event actions, including the ones
+// already finished, when the throttling allows it or when forced
+void SyncEvents::updateProgress(Event *event, bool force)
+{
+    qreal total = event->finished;
+    for (qreal progress : event->actions) {
+        total += progress;
+    }
+    event->progress = total / (event->actions.count() + event->finished);
+
+    // Transfer-ui progress never goes backwards
+    if (event->progress <= event->reported) {
+        return;
+    }
+
+    const qint64 silence = event->lastUpdate.elapsed();
+    if (force || event->progress >= 1
+            || (silence >= MinProgressInterval
+                && (event->progress - event->reported >= MinProgressDelta || silence >= MaxProgressSilence))) {
+        event->reported = event->progress;
+        event->lastUpdate.start();
+        callTransferEngine(QStringLiteral("updateTransferProgress"),
+                           QVariantList() << event->transferId << static_cast<double>(event->reported));
+    } else {
+        scheduleProgress(event);
+    }
+}
+
+// Makes sure a pending progress is reported once the throttling allows it
+void SyncEvents::scheduleProgress(Event *event)
+{
+    const qint64 silence = event->lastUpdate.elapsed();
+    const int wait = event->progress - event->reported >= MinProgressDelta ? MinProgressInterval
+                                                                          : MaxProgressSilence;
+    const int remaining = static_cast<int>(qMax<qint64>(0, wait - silence));
+    if (!_progressTimer->isActive() || _progressTimer->remainingTime() > remaining) {
+        _progressTimer->start(remaining);
+    }
+}
+
+void SyncEvents::finishEvent(Event *event)
+{
+    if (_aggregation != NoAggregation) {
+        _sharedEvents.remove(event->key);
+    }
+
+    QString error;
+    int status = TransferEngineData::TransferFinished;
+    if (event->failed) {
+        //: Notifies in transfer-ui that email sync failed
+        //% "Email Sync Failed"
+        error = qtTrId("qmf-notification_email_sync_failed");
+        status = TransferEngineData::TransferInterrupted;
+    }
+    callTransferEngine(QStringLiteral("finishTransfer"), QVariantList() << event->transferId << status << error);
+    delete event;
+}
+
+// Transfer engine updates don't need a reply, don't block the message server for them
+void SyncEvents::callTransferEngine(const QString &method, const QVariantList &arguments)
+{
+    QDBusMessage message(QDBusMessage::createMethodCall(transferEngineService, transferEnginePath,
+                                                       transferEngineInterface, method));
+    message.setArguments(arguments);
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(
+                QDBusConnection::sessionBus().asyncCall(message), this);
+    connect(watcher, &QDBusPendingCallWatcher::finished,
+            this, &SyncEvents::callFinished);
+    Diagnostics::instance()->increment(Diagnostics::TransferEngineCalls);
+}
+
+// ################ Slots #####################
+
+void SyncEvents::flushProgress()
+{
+    QSet<Event *> events;
+    for (Event *event : _actionEvents) {
+        events.insert(event);
+    }
+    for (Event *event : events) {
+        updateProgress(event);
+    }
+}
+
+void SyncEvents::callFinished(QDBusPendingCallWatcher *watcher)
+{
+    watcher->deleteLater();
+    if (watcher->isError()) {
+        qWarning() << Q_FUNC_INFO << "Transfer engine call failed:" << watcher->error().message();
+    }
+}
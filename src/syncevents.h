@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2026 Jolla Ltd.
+ *
+ * This file is part of qmf-notifications-plugin
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+#ifndef SYNCEVENTS_H
+#define SYNCEVENTS_H
+
+// nemotransferengine-qt5
+#include <transferengineclient.h>
+
+// QMF
+#include <qmailaccount.h>
+
+// Qt
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+#include <QVariantList>
+
+class AccountCache;
+class QDBusPendingCallWatcher;
+class QTimer;
+
+// Maps running sync actions onto transfer-engine sync events, through a
+// single client. Concurrent actions can share one event, either per account
+// or for all accounts, reporting their combined progress.
+class SyncEvents : public QObject
+{
+    Q_OBJECT
+public:
+    enum Aggregation {
+        NoAggregation,
+        AccountAggregation,
+        GlobalAggregation
+    };
+
+    explicit SyncEvents(AccountCache *accounts, QObject *parent = 0);
+    ~SyncEvents();
+
+    Aggregation aggregation() const;
+
+    void actionStarted(quint64 actionId, const QMailAccountId &accountId);
+    void actionProgress(quint64 actionId, qreal progress);
+    void actionFinished(quint64 actionId, bool successful);
+
+private slots:
+    void flushProgress();
+    void callFinished(QDBusPendingCallWatcher *watcher);
+
+private:
+    struct Event
+    {
+        int transferId = 0;
+        quint64 key = 0;
+        qreal progress = 0.0;
+        qreal reported = 0.0;
+        int finished = 0;
+        bool failed = false;
+        QElapsedTimer lastUpdate;
+        QHash<quint64, qreal> actions;
+    };
+
+    Event *createEvent(const QMailAccountId &accountId);
+    void updateProgress(Event *event, bool force = false);
+    void scheduleProgress(Event *event);
+    void finishEvent(Event *event);
+    void callTransferEngine(const QString &method, const QVariantList &arguments);
+
+    Aggregation _aggregation;
+    AccountCache *_accounts;
+    TransferEngineClient *_transferClient;
+    QTimer *_progressTimer;
+    QHash<quint64, Event *> _actionEvents;
+    QHash<quint64, Event *> _sharedEvents;
+};
+
+#endif // SYNCEVENTS_H
@@ -0,0 +1,7 @@
+TEMPLATE = app
+TARGET = tst_actionobserver
+
+include(../common/common.pri)
+
+SOURCES += \
+    tst_actionobserver.cpp
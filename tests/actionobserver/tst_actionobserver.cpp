@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2026 Jolla Ltd.
+ *
+ * This file is part of qmf-notifications-plugin
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+#include "accountcache.h"
+#include "actionobserver.h"
+#include "testenvironment.h"
+
+// QMF
+#include <qmailserviceaction.h>
+
+// Qt
+#include <QtTest>
+
+namespace {
+
+// Actions listed by each actionsChanged update, the server keeps reporting
+// actions for a while after they have completed
+const int ReportedActions = 32;
+const int Accounts = 5;
+// Updates timed together when comparing the start and the end of a run
+const int SampleUpdates = 1000;
+
+typedef QList<QSharedPointer<QMailActionInfo> > ActionList;
+
+// Action infos are normally only created by QMailActionObserver
+class TestActionInfo : public QMailActionInfo
+{
+public:
+    explicit TestActionInfo(const QMailActionData &data)
+        : QMailActionInfo(data)
+    {
+    }
+};
+
+QSharedPointer<QMailActionInfo> createAction(quint64 id)
+{
+    const QMailActionData data(QMailActionId(id), RetrieveMessageListRequestType, 0, 0, 0, QString(),
+                               QMailAccountId(id % Accounts + 1), QMailFolderId(), QMailMessageId());
+    return QSharedPointer<QMailActionInfo>(new TestActionInfo(data));
+}
+
+void actionsChanged(ActionObserver *observer, const ActionList &actions)
+{
+    // The argument type has to be spelled as in the slot signature
+    QMetaObject::invokeMethod(observer, "actionsChanged", Qt::DirectConnection,
+                              Q_ARG(QList<QSharedPointer<QMailActionInfo> >, actions));
+}
+
+void actionCompleted(ActionObserver *observer, quint64 id)
+{
+    QMetaObject::invokeMethod(observer, "actionCompleted", Qt::DirectConnection, Q_ARG(quint64, id));
+}
+
+}
+
+// Stress of the action tracking of a server which never goes idle
+class tst_ActionObserver : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void busyServer_data();
+    void busyServer();
+};
+
+void tst_ActionObserver::busyServer_data()
+{
+    QTest::addColumn<int>("count");
+
+    QTest::newRow("1000") << 1000;
+    QTest::newRow("10000") << 10000;
+    QTest::newRow("100000") << 100000;
+}
+
+// Actions start and complete one after another while the updates keep
+// listing the recently completed ones, the cost per update must stay flat
+void tst_ActionObserver::busyServer()
+{
+    QFETCH(int, count);
+
+    AccountCache accounts;
+    ActionObserver observer(&accounts);
+
+    ActionList actions;
+    actions.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        actions.append(createAction(i + 1));
+    }
+
+    ScenarioReport report(QStringLiteral("busyServer %1").arg(count));
+    QElapsedTimer elapsed;
+    qint64 firstSample = 0;
+    qint64 lastSample = 0;
+    elapsed.start();
+    for (int i = 0; i < count; ++i) {
+        const int first = qMax(0, i - ReportedActions + 1);
+        actionsChanged(&observer, actions.mid(first, i - first + 1));
+        if (i >= ReportedActions / 2) {
+            actionCompleted(&observer, actions.at(i - ReportedActions / 2)->id());
+        }
+
+        if (i == SampleUpdates - 1) {
+            firstSample = elapsed.nsecsElapsed();
+        } else if (i == count - SampleUpdates - 1) {
+            elapsed.restart();
+        }
+    }
+    lastSample = elapsed.nsecsElapsed();
+
+    for (int i = qMax(0, count - ReportedActions / 2); i < count; ++i) {
+        actionCompleted(&observer, actions.at(i)->id());
+    }
+    // Late update listing completed actions
+    actionsChanged(&observer, actions.mid(count - ReportedActions));
+    QVERIFY(!observer.hasRunningAction());
+    report.finish();
+
+    qDebug() << "First" << SampleUpdates << "updates" << firstSample / 1000 << "us, last"
+             << SampleUpdates << "updates" << lastSample / 1000 << "us";
+}
+
+TEST_ENVIRONMENT_MAIN(tst_ActionObserver)
+
+#include "tst_actionobserver.moc"
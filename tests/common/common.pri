@@ -0,0 +1,42 @@
+# Builds the plugin sources into a test, run against the fake notification
+# daemon on a private session bus and a scratch mail store
+
+QT -= gui
+QT += dbus sql testlib
+
+CONFIG += link_pkgconfig
+PKGCONFIG += nemotransferengine-qt5 nemonotifications-qt5 nemoemail-qt5 QmfClient QmfMessageServer
+
+CONFIG -= app_bundle
+CONFIG += testcase
+
+PLUGIN_SRC = $$PWD/../../src
+INCLUDEPATH += $$PLUGIN_SRC $$PWD
+
+DEFINES += FAKE_NOTIFICATIONS_DAEMON=\\\"$$OUT_PWD/../fakenotificationsd/fakenotificationsd\\\"
+
+SOURCES += \
+    $$PLUGIN_SRC/accountcache.cpp \
+    $$PLUGIN_SRC/actionobserver.cpp \
+    $$PLUGIN_SRC/diagnostics.cpp \
+    $$PLUGIN_SRC/mailstoreobserver.cpp \
+    $$PLUGIN_SRC/messageloader.cpp \
+    $$PLUGIN_SRC/notificationqueue.cpp \
+    $$PLUGIN_SRC/notificationregistry.cpp \
+    $$PLUGIN_SRC/publishedmessages.cpp \
+    $$PLUGIN_SRC/publishedsnapshot.cpp \
+    $$PLUGIN_SRC/syncevents.cpp \
+    $$PWD/testenvironment.cpp
+
+HEADERS += \
+    $$PLUGIN_SRC/accountcache.h \
+    $$PLUGIN_SRC/actionobserver.h \
+    $$PLUGIN_SRC/diagnostics.h \
+    $$PLUGIN_SRC/mailstoreobserver.h \
+    $$PLUGIN_SRC/messageloader.h \
+    $$PLUGIN_SRC/notificationqueue.h \
+    $$PLUGIN_SRC/notificationregistry.h \
+    $$PLUGIN_SRC/publishedmessages.h \
+    $$PLUGIN_SRC/publishedsnapshot.h \
+    $$PLUGIN_SRC/syncevents.h \
+    $$PWD/testenvironment.h
@@ -0,0 +1,314 @@
+/*
+ * Copyright (c) 2026 Jolla Ltd.
+ *
+ * This file is part of qmf-notifications-plugin
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+#include "testenvironment.h"
+#include "diagnostics.h"
+
+// QMF
+#include <qmailstore.h>
+
+// Qt
+#include <QDBusConnection>
+#include <QDBusConnectionInterface>
+#include <QDBusMessage>
+#include <QDebug>
+#include <QProcess>
+#include <QTemporaryDir>
+
+#include <sys/resource.h>
+
+namespace {
+
+const auto notificationsService = QStringLiteral("org.freedesktop.Notifications");
+const auto notificationsPath = QStringLiteral("/org/freedesktop/Notifications");
+const auto notificationsInterface = QStringLiteral("org.freedesktop.Notifications");
+
+const int StartTimeout = 5000;
+
+QTemporaryDir *scratchDir = 0;
+QProcess *busDaemon = 0;
+QProcess *notificationsDaemon = 0;
+
+QVariant callDaemon(const QString &method, const QVariantList &arguments = QVariantList())
+{
+    QDBusMessage message(QDBusMessage::createMethodCall(notificationsService, notificationsPath,
+                                                       notificationsInterface, method));
+    message.setArguments(arguments);
+    const QDBusMessage reply(QDBusConnection::sessionBus().call(message));
+    if (reply.type() != QDBusMessage::ReplyMessage) {
+        qWarning() << "Fake notification daemon call failed" << method << reply.errorMessage();
+        return QVariant();
+    }
+    return reply.arguments().value(0);
+}
+
+void stopProcess(QProcess *&process)
+{
+    if (process) {
+        process->terminate();
+        if (!process->waitForFinished(StartTimeout)) {
+            process->kill();
+            process->waitForFinished();
+        }
+        delete process;
+        process = 0;
+    }
+}
+
+}
+
+namespace TestEnvironment {
+
+bool start()
+{
+    scratchDir = new QTemporaryDir;
+    if (!scratchDir->isValid()) {
+        qWarning() << "Cannot create a scratch directory";
+        return false;
+    }
+    qputenv("QMF_DATA", scratchDir->path().toUtf8());
+    qputenv("XDG_CACHE_HOME", QString(scratchDir->path() + QStringLiteral("/cache")).toUtf8());
+
+    busDaemon = new QProcess;
+    busDaemon->start(QStringLiteral("dbus-daemon"),
+                     QStringList() << QStringLiteral("--session") << QStringLiteral("--nofork")
+                                   << QStringLiteral("--print-address"));
+    while (!busDaemon->canReadLine() && busDaemon->waitForReadyRead(StartTimeout)) {
+    }
+    if (!busDaemon->canReadLine()) {
+        qWarning() << "Cannot start a private session bus";
+        return false;
+    }
+    qputenv("DBUS_SESSION_BUS_ADDRESS", busDaemon->readLine().trimmed());
+
+    notificationsDaemon = new QProcess;
+    notificationsDaemon->setProcessChannelMode(QProcess::ForwardedChannels);
+    notificationsDaemon->start(QStringLiteral(FAKE_NOTIFICATIONS_DAEMON));
+
+    QDBusConnectionInterface *bus = QDBusConnection::sessionBus().interface();
+    QElapsedTimer waited;
+    waited.start();
+    while (!bus->isServiceRegistered(notificationsService)) {
+        if (waited.elapsed() > StartTimeout) {
+            qWarning() << "Fake notification daemon did not start";
+            return false;
+        }
+        QTest::qWait(20);
+    }
+    return true;
+}
+
+void stop()
+{
+    stopProcess(notificationsDaemon);
+    stopProcess(busDaemon);
+    delete scratchDir;
+    scratchDir = 0;
+}
+
+QMailAccountId addAccount(const QString &name, bool synchronized)
+{
+    QMailStore *store = QMailStore::instance();
+
+    QMailAccount account;
+    account.setName(name);
+    account.setMessageType(QMailMessage::Email);
+    account.setFromAddress(QMailAddress(name, name + QStringLiteral("@example.org")));
+    account.setStatus(QMailAccount::Enabled, true);
+    if (!store->addAccount(&account, 0)) {
+        qWarning() << "Cannot add account" << name;
+        return QMailAccountId();
+    }
+
+    QMailFolder inbox(QStringLiteral("INBOX"), QMailFolderId(), account.id());
+    inbox.setDisplayName(QStringLiteral("Inbox"));
+    inbox.setStatus(QMailFolder::Incoming | QMailFolder::SynchronizationEnabled, true);
+    if (!store->addFolder(&inbox)) {
+        qWarning() << "Cannot add inbox of" << name;
+        return QMailAccountId();
+    }
+
+    account.setStandardFolder(QMail::InboxFolder, inbox.id());
+    if (synchronized) {
+        account.setLastSynchronized(QMailTimeStamp::currentDateTime());
+    }
+    store->updateAccount(&account);
+    if (QMailAccount(account.id()).foldersToSync().isEmpty()) {
+        qWarning() << "No folders to sync for" << name << "its messages are not notified";
+    }
+    return account.id();
+}
+
+QMailFolderId inbox(const QMailAccountId &accountId)
+{
+    return QMailAccount(accountId).standardFolder(QMail::InboxFolder);
+}
+
+QMailMessageIdList addMessages(const QMailAccountId &accountId, int count)
+{
+    static int serial = 0;
+    const QMailFolderId folderId(inbox(accountId));
+    const QMailTimeStamp now(QMailTimeStamp::currentDateTime());
+
+    QList<QMailMessage> messages;
+    messages.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        const int number = ++serial;
+        QMailMessage message;
+        message.setMessageType(QMailMessage::Email);
+        message.setParentAccountId(accountId);
+        message.setParentFolderId(folderId);
+        message.setFrom(QMailAddress(QStringLiteral("Sender %1").arg(number % 7),
+                                     QStringLiteral("sender%1@example.org").arg(number % 7)));
+        message.setTo(QMailAddress(QStringLiteral("me@example.org")));
+        message.setSubject(QStringLiteral("Message %1").arg(number));
+        message.setDate(now);
+        message.setReceivedDate(now);
+        message.setStatus(QMailMessage::Incoming | QMailMessage::New, true);
+        messages.append(message);
+    }
+
+    QList<QMailMessage *> pointers;
+    for (QMailMessage &message : messages) {
+        pointers.append(&message);
+    }
+    QMailMessageIdList ids;
+    if (!QMailStore::instance()->addMessages(pointers)) {
+        qWarning() << "Cannot add messages to account" << accountId;
+        return ids;
+    }
+    for (const QMailMessage &message : messages) {
+        ids.append(message.id());
+    }
+    return ids;
+}
+
+QMailMessageId addMessage(const QMailAccountId &accountId, const QString &rfcId)
+{
+    const QMailTimeStamp now(QMailTimeStamp::currentDateTime());
+    QMailMessage message;
+    message.setMessageType(QMailMessage::Email);
+    message.setParentAccountId(accountId);
+    message.setParentFolderId(inbox(accountId));
+    message.setFrom(QMailAddress(QStringLiteral("Sender"), QStringLiteral("sender@example.org")));
+    message.setTo(QMailAddress(QStringLiteral("me@example.org")));
+    message.setSubject(QStringLiteral("Message %1").arg(rfcId));
+    message.setDate(now);
+    message.setReceivedDate(now);
+    message.setRfcId(rfcId);
+    message.setStatus(QMailMessage::Incoming | QMailMessage::New, true);
+    if (!QMailStore::instance()->addMessage(&message)) {
+        qWarning() << "Cannot add message to account" << accountId;
+    }
+    return message.id();
+}
+
+void setSynchronized(const QMailAccountId &accountId)
+{
+    QMailAccount account(accountId);
+    account.setLastSynchronized(QMailTimeStamp::currentDateTime());
+    QMailStore::instance()->updateAccount(&account);
+}
+
+void clearStore()
+{
+    QMailStore::instance()->clearContent();
+}
+
+}
+
+namespace FakeNotifications {
+
+uint callCount()
+{
+    return callDaemon(QStringLiteral("TestCallCount")).toUInt();
+}
+
+uint notificationCount()
+{
+    return callDaemon(QStringLiteral("TestNotificationCount")).toUInt();
+}
+
+uint hintCount(const QString &hint)
+{
+    return callDaemon(QStringLiteral("TestHintCount"), QVariantList() << hint).toUInt();
+}
+
+QStringList hintValues(const QString &hint)
+{
+    return callDaemon(QStringLiteral("TestHintValues"), QVariantList() << hint).toStringList();
+}
+
+void reset()
+{
+    callDaemon(QStringLiteral("TestReset"));
+}
+
+void clear()
+{
+    callDaemon(QStringLiteral("TestClear"));
+}
+
+}
+
+ScenarioReport::ScenarioReport(const QString &name)
+    : _name(name)
+    , _finished(false)
+{
+    Diagnostics::instance()->reset();
+    FakeNotifications::reset();
+    _elapsed.start();
+}
+
+ScenarioReport::~ScenarioReport()
+{
+    finish();
+}
+
+void ScenarioReport::finish()
+{
+    if (_finished) {
+        return;
+    }
+    _finished = true;
+
+    const qint64 wallTime = _elapsed.elapsed();
+    const QVariantMap counters(Diagnostics::instance()->statistics().value(QStringLiteral("counters")).toMap());
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    qDebug().nospace() << qPrintable(_name) << ": wall time " << wallTime << " ms, store queries "
+                       << counters.value(QStringLiteral("storeQueries")).toULongLong()
+                       << ", notification daemon calls " << FakeNotifications::callCount()
+                       << ", peak RSS " << usage.ru_maxrss << " kB";
+}
@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2026 Jolla Ltd.
+ *
+ * This file is part of qmf-notifications-plugin
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+#ifndef TESTENVIRONMENT_H
+#define TESTENVIRONMENT_H
+
+// QMF
+#include <qmailaccount.h>
+#include <qmailfolder.h>
+#include <qmailmessage.h>
+
+// Qt
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QString>
+#include <QtTest>
+
+// Runs the tests against a private session bus owned by the fake notification
+// daemon, with the mail store kept in a scratch directory
+namespace TestEnvironment {
+
+// Must be called before anything uses D-Bus or the mail store
+bool start();
+void stop();
+
+// Adds an enabled email account with an inbox to sync. Accounts which have
+// been synchronized are not in their first sync.
+QMailAccountId addAccount(const QString &name, bool synchronized);
+QMailFolderId inbox(const QMailAccountId &accountId);
+// Adds count unread messages to the inbox of the account
+QMailMessageIdList addMessages(const QMailAccountId &accountId, int count);
+// Adds an unread message with the Message-ID to the inbox of the account,
+// like the copy of a message sent to several accounts
+QMailMessageId addMessage(const QMailAccountId &accountId, const QString &rfcId);
+void setSynchronized(const QMailAccountId &accountId);
+// Removes the accounts and messages of the previous scenario
+void clearStore();
+
+}
+
+// Calls to the fake notification daemon, these are not counted by it
+namespace FakeNotifications {
+
+uint callCount();
+uint notificationCount();
+uint hintCount(const QString &hint);
+QStringList hintValues(const QString &hint);
+void reset();
+void clear();
+
+}
+
+// Reports the wall time, store queries, notification daemon calls and the
+// peak RSS of the process for a scenario, the counters start from zero
+class ScenarioReport
+{
+public:
+    explicit ScenarioReport(const QString &name);
+    ~ScenarioReport();
+
+    void finish();
+
+private:
+    QString _name;
+    QElapsedTimer _elapsed;
+    bool _finished;
+};
+
+#define TEST_ENVIRONMENT_MAIN(TestObject) \
+int main(int argc, char *argv[]) \
+{ \
+    QCoreApplication app(argc, argv); \
+    if (!TestEnvironment::start()) { \
+        return 1; \
+    } \
+    int result; \
+    { \
+        TestObject test; \
+        result = QTest::qExec(&test, argc, argv); \
+    } \
+    TestEnvironment::stop(); \
+    return result; \
+}
+
+#endif // TESTENVIRONMENT_H
@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) 2026 Jolla Ltd.
+ *
+ * This file is part of qmf-notifications-plugin
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+#include "fakenotifications.h"
+
+namespace {
+
+// Reason reported for notifications closed by a CloseNotification call
+const uint ClosedByCall = 3;
+
+}
+
+QDBusArgument &operator<<(QDBusArgument &argument, const StoredNotification &notification)
+{
+    argument.beginStructure();
+    argument << notification.appName << notification.id << notification.appIcon << notification.summary
+             << notification.body << notification.actions << notification.hints << notification.expireTimeout;
+    argument.endStructure();
+    return argument;
+}
+
+const QDBusArgument &operator>>(const QDBusArgument &argument, StoredNotification &notification)
+{
+    argument.beginStructure();
+    argument >> notification.appName >> notification.id >> notification.appIcon >> notification.summary
+             >> notification.body >> notification.actions >> notification.hints >> notification.expireTimeout;
+    argument.endStructure();
+    return argument;
+}
+
+FakeNotifications::FakeNotifications(QObject *parent)
+    : QObject(parent)
+    , _lastId(0)
+    , _calls(0)
+{
+}
+
+// ################ Slots #####################
+
+QStringList FakeNotifications::GetCapabilities()
+{
+    ++_calls;
+    return QStringList() << QStringLiteral("body") << QStringLiteral("actions")
+                         << QStringLiteral("x-nemo-remote-actions");
+}
+
+QString FakeNotifications::GetServerInformation(QString &vendor, QString &version, QString &specVersion)
+{
+    ++_calls;
+    vendor = QStringLiteral("Nemo Mobile");
+    version = QStringLiteral("1.0");
+    specVersion = QStringLiteral("1.2");
+    return QStringLiteral("fakenotificationsd");
+}
+
+uint FakeNotifications::Notify(const QString &appName, uint replacesId, const QString &appIcon,
+                               const QString &summary, const QString &body, const QStringList &actions,
+                               const QVariantMap &hints, int expireTimeout)
+{
+    ++_calls;
+
+    const uint id = replacesId && _notifications.contains(replacesId) ? replacesId : ++_lastId;
+    // Transient notifications are only shown, they are not kept
+    if (hints.value(QStringLiteral("transient")).toBool()) {
+        return id;
+    }
+
+    StoredNotification &notification(_notifications[id]);
+    notification.appName = appName;
+    notification.id = id;
+    notification.appIcon = appIcon;
+    notification.summary = summary;
+    notification.body = body;
+    notification.actions = actions;
+    notification.hints = hints;
+    notification.expireTimeout = expireTimeout;
+    return id;
+}
+
+void FakeNotifications::CloseNotification(uint id)
+{
+    ++_calls;
+    if (_notifications.remove(id)) {
+        emit NotificationClosed(id, ClosedByCall);
+    }
+}
+
+StoredNotificationList FakeNotifications::GetNotifications(const QString &owner)
+{
+    Q_UNUSED(owner)
+    ++_calls;
+    return _notifications.values();
+}
+
+uint FakeNotifications::TestCallCount() const
+{
+    return _calls;
+}
+
+uint FakeNotifications::TestNotificationCount() const
+{
+    return _notifications.count();
+}
+
+uint FakeNotifications::TestHintCount(const QString &hint) const
+{
+    uint count = 0;
+    for (const StoredNotification &notification : _notifications) {
+        if (notification.hints.contains(hint)) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+QStringList FakeNotifications::TestHintValues(const QString &hint) const
+{
+    QStringList values;
+    for (const StoredNotification &notification : _notifications) {
+        if (notification.hints.contains(hint)) {
+            values.append(notification.hints.value(hint).toString());
+        }
+    }
+    return values;
+}
+
+void FakeNotifications::TestReset()
+{
+    _calls = 0;
+}
+
+void FakeNotifications::TestClear()
+{
+    _notifications.clear();
+}
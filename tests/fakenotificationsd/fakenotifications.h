@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2026 Jolla Ltd.
+ *
+ * This file is part of qmf-notifications-plugin
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+#ifndef FAKENOTIFICATIONS_H
+#define FAKENOTIFICATIONS_H
+
+// Qt
+#include <QDBusArgument>
+#include <QDBusContext>
+#include <QHash>
+#include <QList>
+#include <QMetaType>
+#include <QObject>
+#include <QStringList>
+#include <QVariantMap>
+
+struct StoredNotification
+{
+    QString appName;
+    uint id = 0;
+    QString appIcon;
+    QString summary;
+    QString body;
+    QStringList actions;
+    QVariantMap hints;
+    int expireTimeout = -1;
+};
+
+typedef QList<StoredNotification> StoredNotificationList;
+
+Q_DECLARE_METATYPE(StoredNotification)
+Q_DECLARE_METATYPE(StoredNotificationList)
+
+QDBusArgument &operator<<(QDBusArgument &argument, const StoredNotification &notification);
+const QDBusArgument &operator>>(const QDBusArgument &argument, StoredNotification &notification);
+
+// Stand-in for the notification daemon. It keeps the published notifications
+// and counts the calls made to it, the Test methods are not counted.
+class FakeNotifications : public QObject, protected QDBusContext
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "org.freedesktop.Notifications")
+public:
+    explicit FakeNotifications(QObject *parent = 0);
+
+public slots:
+    QStringList GetCapabilities();
+    QString GetServerInformation(QString &vendor, QString &version, QString &specVersion);
+    uint Notify(const QString &appName, uint replacesId, const QString &appIcon, const QString &summary,
+                const QString &body, const QStringList &actions, const QVariantMap &hints, int expireTimeout);
+    void CloseNotification(uint id);
+    StoredNotificationList GetNotifications(const QString &owner);
+
+    uint TestCallCount() const;
+    uint TestNotificationCount() const;
+    // Number of notifications having the hint set
+    uint TestHintCount(const QString &hint) const;
+    // Values of the hint in the notifications having it set
+    QStringList TestHintValues(const QString &hint) const;
+    void TestReset();
+    // Drops the notifications without reporting them closed
+    void TestClear();
+
+signals:
+    void NotificationClosed(uint id, uint reason);
+    void ActionInvoked(uint id, const QString &actionKey);
+
+private:
+    QHash<uint, StoredNotification> _notifications;
+    uint _lastId;
+    uint _calls;
+};
+
+#endif // FAKENOTIFICATIONS_H
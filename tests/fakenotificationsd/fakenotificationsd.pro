@@ -0,0 +1,13 @@
+TEMPLATE = app
+TARGET = fakenotificationsd
+CONFIG -= app_bundle
+
+QT -= gui
+QT += dbus
+
+SOURCES += \
+    fakenotifications.cpp \
+    main.cpp
+
+HEADERS += \
+    fakenotifications.h
@@ -0,0 +1,7 @@
+TEMPLATE = app
+TARGET = tst_mailstoreobserver
+
+include(../common/common.pri)
+
+SOURCES += \
+    tst_mailstoreobserver.cpp
@@ -0,0 +1,422 @@
+/*
+ * Copyright (c) 2026 Jolla Ltd.
+ *
+ * This file is part of qmf-notifications-plugin
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+#include "accountcache.h"
+#include "diagnostics.h"
+#include "mailstoreobserver.h"
+#include "publishedsnapshot.h"
+#include "testenvironment.h"
+
+// QMF
+#include <qmailstore.h>
+
+// Qt
+#include <QSignalSpy>
+#include <QtTest>
+
+namespace {
+
+const auto publishedMessageId = QStringLiteral("x-nemo.email.published-message-id");
+const auto firstSyncAccountId = QStringLiteral("x-nemo.email.firstSync-accountId");
+
+// Messages are added to the store in batches of this size, like a sync does
+const int BatchSize = 50;
+const int ScenarioTimeout = 60000;
+
+int signalledIds(const QSignalSpy &spy)
+{
+    int count = 0;
+    for (const QList<QVariant> &arguments : spy) {
+        count += arguments.at(0).value<QMailMessageIdList>().count();
+    }
+    return count;
+}
+
+quint64 counter(const QString &name)
+{
+    return Diagnostics::instance()->statistics().value(QStringLiteral("counters")).toMap()
+            .value(name).toULongLong();
+}
+
+quint64 timerCount(const QString &name)
+{
+    return Diagnostics::instance()->statistics().value(QStringLiteral("timers")).toMap()
+            .value(name).toMap().value(QStringLiteral("count")).toULongLong();
+}
+
+}
+
+// Scenarios of MailStoreObserver against the fake notification daemon, each
+// one reports its costs
+class tst_MailStoreObserver : public QObject
+{
+    Q_OBJECT
+public:
+    tst_MailStoreObserver();
+
+private slots:
+    void initTestCase();
+    void init();
+    void cleanup();
+
+    void firstSync_data();
+    void firstSync();
+    void firstSyncRead();
+    void bulkRead_data();
+    void bulkRead();
+    void syncStorm_data();
+    void syncStorm();
+    void startup_data();
+    void startup();
+    void staleSnapshot();
+    void duplicateCopies_data();
+    void duplicateCopies();
+
+private:
+    void addAccounts(const QString &name, int count, bool synchronized);
+    void addMessages(int perAccount);
+    void createObserver();
+    void destroyObserver();
+
+    AccountCache *_accounts;
+    MailStoreObserver *_observer;
+    QList<QMailAccountId> _accountIds;
+};
+
+tst_MailStoreObserver::tst_MailStoreObserver()
+    : _accounts(0)
+    , _observer(0)
+{
+}
+
+void tst_MailStoreObserver::initTestCase()
+{
+    qRegisterMetaType<QMailAccountIdList>();
+    qRegisterMetaType<QMailMessageIdList>();
+}
+
+void tst_MailStoreObserver::init()
+{
+    TestEnvironment::clearStore();
+    PublishedSnapshot::remove();
+    FakeNotifications::clear();
+    // Let the store signals of the previous scenario pass
+    QTest::qWait(200);
+}
+
+void tst_MailStoreObserver::cleanup()
+{
+    destroyObserver();
+    _accountIds.clear();
+}
+
+// Adds the accounts and waits for the store to report them
+void tst_MailStoreObserver::addAccounts(const QString &name, int count, bool synchronized)
+{
+    QSignalSpy added(QMailStore::instance(), &QMailStore::accountsAdded);
+    for (int i = 0; i < count; ++i) {
+        const QMailAccountId accountId(TestEnvironment::addAccount(name + QString::number(i), synchronized));
+        QVERIFY(accountId.isValid());
+        _accountIds.append(accountId);
+    }
+    QTRY_VERIFY_WITH_TIMEOUT(!added.isEmpty(), ScenarioTimeout);
+}
+
+// Adds the messages to the accounts in turns and waits for the store to report them
+void tst_MailStoreObserver::addMessages(int perAccount)
+{
+    QSignalSpy added(QMailStore::instance(), &QMailStore::messagesAdded);
+    for (int sent = 0; sent < perAccount; sent += BatchSize) {
+        const int batch = qMin(BatchSize, perAccount - sent);
+        for (const QMailAccountId &accountId : _accountIds) {
+            QCOMPARE(TestEnvironment::addMessages(accountId, batch).count(), batch);
+        }
+    }
+    QTRY_COMPARE_WITH_TIMEOUT(signalledIds(added), perAccount * _accountIds.count(), ScenarioTimeout);
+}
+
+// Creates the observer as the plugin does without running actions, and waits
+// for it to reload the existing notifications
+void tst_MailStoreObserver::createObserver()
+{
+    const quint64 reloads = timerCount(QStringLiteral("reload"));
+    _accounts = new AccountCache;
+    _observer = new MailStoreObserver(_accounts);
+    connect(_observer, &MailStoreObserver::mailStoreChanges,
+            _observer, &MailStoreObserver::publishChanges);
+    QTRY_VERIFY_WITH_TIMEOUT(timerCount(QStringLiteral("reload")) > reloads, ScenarioTimeout);
+}
+
+void tst_MailStoreObserver::destroyObserver()
+{
+    delete _observer;
+    _observer = 0;
+    delete _accounts;
+    _accounts = 0;
+}
+
+void tst_MailStoreObserver::firstSync_data()
+{
+    QTest::addColumn<int>("count");
+
+    QTest::newRow("100") << 100;
+    QTest::newRow("2000") << 2000;
+}
+
+// All messages of the first sync of an account end up in one summary
+void tst_MailStoreObserver::firstSync()
+{
+    QFETCH(int, count);
+
+    createObserver();
+
+    ScenarioReport report(QStringLiteral("firstSync %1").arg(count));
+    addAccounts(QStringLiteral("firstsync"), 1, false);
+    addMessages(count);
+    const QMailAccountId accountId(_accountIds.first());
+
+    TestEnvironment::setSynchronized(accountId);
+    _observer->publishAccountChanges(accountId);
+
+    QTRY_COMPARE_WITH_TIMEOUT(FakeNotifications::hintCount(firstSyncAccountId), 1u, ScenarioTimeout);
+    QCOMPARE(FakeNotifications::hintCount(publishedMessageId), 0u);
+    report.finish();
+}
+
+// The first sync summary follows its messages, it is closed once they are all read
+void tst_MailStoreObserver::firstSyncRead()
+{
+    createObserver();
+    addAccounts(QStringLiteral("firstsyncread"), 1, false);
+    addMessages(BatchSize);
+    const QMailAccountId accountId(_accountIds.first());
+
+    TestEnvironment::setSynchronized(accountId);
+    _observer->publishAccountChanges(accountId);
+    QTRY_COMPARE_WITH_TIMEOUT(FakeNotifications::hintCount(firstSyncAccountId), 1u, ScenarioTimeout);
+
+    // Removing some of the messages only lowers the count
+    QMailStore *store = QMailStore::instance();
+    const QMailMessageIdList ids(store->queryMessages(QMailMessageKey::parentAccountId(accountId)));
+    QCOMPARE(ids.count(), BatchSize);
+    const quint64 published = counter(QStringLiteral("notificationsPublished"));
+    QVERIFY(store->removeMessages(QMailMessageKey::id(ids.mid(0, 10))));
+    QTRY_VERIFY_WITH_TIMEOUT(counter(QStringLiteral("notificationsPublished")) > published, ScenarioTimeout);
+    QCOMPARE(FakeNotifications::hintCount(firstSyncAccountId), 1u);
+
+    QVERIFY(store->updateMessagesMetaData(QMailMessageKey::parentAccountId(accountId),
+                                          QMailMessage::Read, true));
+    QTRY_COMPARE_WITH_TIMEOUT(FakeNotifications::hintCount(firstSyncAccountId), 0u, ScenarioTimeout);
+}
+
+void tst_MailStoreObserver::bulkRead_data()
+{
+    QTest::addColumn<int>("accounts");
+    QTest::addColumn<int>("perAccount");
+
+    QTest::newRow("1x100") << 1 << 100;
+    QTest::newRow("5x100") << 5 << 100;
+}
+
+// Messages read elsewhere close their notifications
+void tst_MailStoreObserver::bulkRead()
+{
+    QFETCH(int, accounts);
+    QFETCH(int, perAccount);
+
+    addAccounts(QStringLiteral("reader"), accounts, true);
+    createObserver();
+    addMessages(perAccount);
+
+    const uint published = accounts * perAccount;
+    QTRY_COMPARE_WITH_TIMEOUT(FakeNotifications::hintCount(publishedMessageId), published, ScenarioTimeout);
+
+    ScenarioReport report(QStringLiteral("bulkRead %1x%2").arg(accounts).arg(perAccount));
+    QVERIFY(QMailStore::instance()->updateMessagesMetaData(QMailMessageKey::messageType(QMailMessage::Email),
+                                                           QMailMessage::Read, true));
+    QTRY_COMPARE_WITH_TIMEOUT(FakeNotifications::hintCount(publishedMessageId), 0u, ScenarioTimeout);
+    QCOMPARE(counter(QStringLiteral("notificationsPublished")), quint64(0));
+    report.finish();
+}
+
+void tst_MailStoreObserver::syncStorm_data()
+{
+    QTest::addColumn<int>("accounts");
+    QTest::addColumn<int>("perAccount");
+
+    QTest::newRow("10x20") << 10 << 20;
+    QTest::newRow("10x100") << 10 << 100;
+}
+
+// Concurrent syncs of several accounts add their messages in turns
+void tst_MailStoreObserver::syncStorm()
+{
+    QFETCH(int, accounts);
+    QFETCH(int, perAccount);
+
+    addAccounts(QStringLiteral("storm"), accounts, true);
+    createObserver();
+
+    ScenarioReport report(QStringLiteral("syncStorm %1x%2").arg(accounts).arg(perAccount));
+    addMessages(perAccount);
+    QTRY_COMPARE_WITH_TIMEOUT(FakeNotifications::hintCount(publishedMessageId),
+                              static_cast<uint>(accounts * perAccount), ScenarioTimeout);
+    report.finish();
+}
+
+void tst_MailStoreObserver::startup_data()
+{
+    QTest::addColumn<int>("accounts");
+    QTest::addColumn<bool>("snapshot");
+
+    QTest::newRow("1x100 reload") << 1 << false;
+    QTest::newRow("1x100 snapshot") << 1 << true;
+    QTest::newRow("5x100 reload") << 5 << false;
+    QTest::newRow("5x100 snapshot") << 5 << true;
+}
+
+// Notifications published before a restart are kept, they are not published again
+void tst_MailStoreObserver::startup()
+{
+    QFETCH(int, accounts);
+    QFETCH(bool, snapshot);
+
+    const int perAccount = 100;
+    addAccounts(QStringLiteral("startup"), accounts, true);
+    createObserver();
+    addMessages(perAccount);
+
+    const uint published = accounts * perAccount;
+    QTRY_COMPARE_WITH_TIMEOUT(FakeNotifications::hintCount(publishedMessageId), published, ScenarioTimeout);
+    // Let the observer settle before it saves the snapshot
+    QTest::qWait(200);
+    destroyObserver();
+    if (!snapshot) {
+        PublishedSnapshot::remove();
+    }
+
+    ScenarioReport report(QStringLiteral("startup %1 %2").arg(published)
+                          .arg(snapshot ? QStringLiteral("snapshot") : QStringLiteral("reload")));
+    createObserver();
+    QCOMPARE(FakeNotifications::hintCount(publishedMessageId), published);
+    QCOMPARE(counter(QStringLiteral("notificationsPublished")), quint64(0));
+    QCOMPARE(counter(QStringLiteral("notificationsClosed")), quint64(0));
+    report.finish();
+}
+
+// Messages read or removed while the message server was down have their
+// notifications closed on the next start, although they are in the snapshot
+void tst_MailStoreObserver::staleSnapshot()
+{
+    addAccounts(QStringLiteral("stale"), 1, true);
+    createObserver();
+    addMessages(BatchSize);
+
+    QTRY_COMPARE_WITH_TIMEOUT(FakeNotifications::hintCount(publishedMessageId),
+                              static_cast<uint>(BatchSize), ScenarioTimeout);
+    QTest::qWait(200);
+    destroyObserver();
+
+    QMailStore *store = QMailStore::instance();
+    const QMailMessageIdList ids(store->queryMessages(QMailMessageKey::parentAccountId(_accountIds.first())));
+    QCOMPARE(ids.count(), BatchSize);
+    QVERIFY(store->updateMessagesMetaData(QMailMessageKey::id(ids.mid(0, 10)), QMailMessage::Read, true));
+    QVERIFY(store->removeMessages(QMailMessageKey::id(ids.mid(10, 10))));
+    // Let the store signals pass while nothing observes them
+    QTest::qWait(200);
+
+    Diagnostics::instance()->reset();
+    createObserver();
+    QTRY_COMPARE_WITH_TIMEOUT(FakeNotifications::hintCount(publishedMessageId),
+                              static_cast<uint>(BatchSize - 20), ScenarioTimeout);
+    QCOMPARE(counter(QStringLiteral("notificationsPublished")), quint64(0));
+}
+
+void tst_MailStoreObserver::duplicateCopies_data()
+{
+    QTest::addColumn<bool>("original");
+    QTest::addColumn<bool>("remove");
+
+    QTest::newRow("remove original") << true << true;
+    QTest::newRow("read original") << true << false;
+    QTest::newRow("remove copy") << false << true;
+    QTest::newRow("read copy") << false << false;
+}
+
+// A message delivered to two accounts has one notification, it stays as
+// long as one of its copies is unread
+void tst_MailStoreObserver::duplicateCopies()
+{
+    QFETCH(bool, original);
+    QFETCH(bool, remove);
+
+    addAccounts(QStringLiteral("copies"), 2, true);
+    createObserver();
+    Diagnostics::instance()->reset();
+
+    const QString rfcId(QStringLiteral("<copies@example.org>"));
+    const QMailMessageId firstId(TestEnvironment::addMessage(_accountIds.at(0), rfcId));
+    QVERIFY(firstId.isValid());
+    QTRY_COMPARE_WITH_TIMEOUT(FakeNotifications::hintCount(publishedMessageId), 1u, ScenarioTimeout);
+    const QMailMessageId secondId(TestEnvironment::addMessage(_accountIds.at(1), rfcId));
+    QVERIFY(secondId.isValid());
+    QTRY_COMPARE_WITH_TIMEOUT(counter(QStringLiteral("duplicateMessages")), quint64(1), ScenarioTimeout);
+    QCOMPARE(FakeNotifications::hintValues(publishedMessageId),
+             QStringList() << QString::number(firstId.toULongLong()));
+
+    const QMailMessageId goneId(original ? firstId : secondId);
+    const QMailMessageId remainingId(original ? secondId : firstId);
+    QMailStore *store = QMailStore::instance();
+    const quint64 published = timerCount(QStringLiteral("publishChanges"));
+    if (remove) {
+        QVERIFY(store->removeMessages(QMailMessageKey::id(goneId)));
+    } else {
+        QVERIFY(store->updateMessagesMetaData(QMailMessageKey::id(goneId), QMailMessage::Read, true));
+    }
+    // The remaining copy keeps the notification
+    QTRY_VERIFY_WITH_TIMEOUT(timerCount(QStringLiteral("publishChanges")) > published, ScenarioTimeout);
+    QTRY_COMPARE_WITH_TIMEOUT(FakeNotifications::hintValues(publishedMessageId),
+                              QStringList() << QString::number(remainingId.toULongLong()), ScenarioTimeout);
+    QCOMPARE(counter(QStringLiteral("promotedCopies")), quint64(original ? 1 : 0));
+
+    if (remove) {
+        QVERIFY(store->removeMessages(QMailMessageKey::id(remainingId)));
+    } else {
+        QVERIFY(store->updateMessagesMetaData(QMailMessageKey::id(remainingId), QMailMessage::Read, true));
+    }
+    QTRY_COMPARE_WITH_TIMEOUT(FakeNotifications::hintCount(publishedMessageId), 0u, ScenarioTimeout);
+}
+
+TEST_ENVIRONMENT_MAIN(tst_MailStoreObserver)
+
+#include "tst_mailstoreobserver.moc"
@@ -0,0 +1,7 @@
+TEMPLATE = app
+TARGET = tst_messageloader
+
+include(../common/common.pri)
+
+SOURCES += \
+    tst_messageloader.cpp
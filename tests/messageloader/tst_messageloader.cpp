@@ -0,0 +1,275 @@
+/*
+ * Copyright (c) 2026 Jolla Ltd.
+ *
+ * This file is part of qmf-notifications-plugin
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * "Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Nemo Mobile nor the names of its contributors
+ *     may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+ */
+
+#include "messageloader.h"
+#include "testenvironment.h"
+
+// QMF
+#include <qmailstore.h>
+
+// Qt
+#include <QFile>
+#include <QSignalSpy>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QTemporaryDir>
+#include <QtTest>
+
+#include <algorithm>
+
+namespace {
+
+const quint64 NotifiedStatus = QMailMessage::Read
+        | QMailMessage::Temporary
+        | QMailMessage::NoNotification
+        | QMailMessage::Junk
+        | QMailMessage::Trash;
+
+bool idLessThan(const MessageInfo &a, const MessageInfo &b)
+{
+    return a.id.toULongLong() < b.id.toULongLong();
+}
+
+}
+
+// The worker thread queries the store database directly, it must select the
+// same messages as MessageFilter::key() and read the same data as the store
+class tst_MessageLoader : public QObject
+{
+    Q_OBJECT
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void sameAsStore_data();
+    void sameAsStore();
+    void unknownSchema();
+
+private:
+    QMailMessageId addMessage(const QMailAccountId &accountId, const QMailFolderId &folderId,
+                              const QString &subject, quint64 status,
+                              QMailMessage::MessageType type = QMailMessage::Email);
+    bool load(const QString &databasePath, const MessageFilter &filter,
+              MessageInfoList *messages, CountedMessages *counted);
+
+    QMailAccountId _firstAccount;
+    QMailAccountId _secondAccount;
+    QMailFolderId _archive;
+    QMailMessageIdList _ids;
+};
+
+void tst_MessageLoader::initTestCase()
+{
+    qRegisterMetaType<MessageInfoList>("MessageInfoList");
+    qRegisterMetaType<CountedMessages>("CountedMessages");
+
+    TestEnvironment::clearStore();
+    _firstAccount = TestEnvironment::addAccount(QStringLiteral("first"), true);
+    _secondAccount = TestEnvironment::addAccount(QStringLiteral("second"), true);
+    QVERIFY(_firstAccount.isValid() && _secondAccount.isValid());
+
+    QMailFolder archive(QStringLiteral("Archive"), QMailFolderId(), _firstAccount);
+    QVERIFY(QMailStore::instance()->addFolder(&archive));
+    _archive = archive.id();
+
+    const QMailFolderId firstInbox(TestEnvironment::inbox(_firstAccount));
+    const QMailFolderId secondInbox(TestEnvironment::inbox(_secondAccount));
+    _ids << addMessage(_firstAccount, firstInbox, QStringLiteral("Unread"), 0)
+         << addMessage(_firstAccount, firstInbox, QStringLiteral("Read"), QMailMessage::Read)
+         << addMessage(_firstAccount, firstInbox, QStringLiteral("Junk"), QMailMessage::Junk)
+         << addMessage(_firstAccount, firstInbox, QStringLiteral("Trash"), QMailMessage::Trash)
+         << addMessage(_firstAccount, firstInbox, QStringLiteral("Temporary"), QMailMessage::Temporary)
+         << addMessage(_firstAccount, firstInbox, QStringLiteral("Old"), QMailMessage::NoNotification)
+         << addMessage(_firstAccount, firstInbox, QStringLiteral("Sms"), 0, QMailMessage::Sms)
+         << addMessage(_firstAccount, _archive, QStringLiteral("Archived"), 0)
+         << addMessage(_secondAccount, secondInbox, QStringLiteral("Second"), 0)
+         << addMessage(_secondAccount, secondInbox, QStringLiteral("Second read"), QMailMessage::Read);
+
+    // Replies share the thread and have several recipients
+    QMailMessage reply(QMailStore::instance()->message(_ids.first()));
+    reply.setId(QMailMessageId());
+    reply.setSubject(QStringLiteral("Re: Unread"));
+    reply.setTo(QList<QMailAddress>() << QMailAddress(QStringLiteral("me@example.org"))
+                                      << QMailAddress(QStringLiteral("you@example.org")));
+    reply.setInResponseTo(reply.rfcId());
+    reply.setRfcId(QStringLiteral("<reply@example.org>"));
+    QVERIFY(QMailStore::instance()->addMessage(&reply));
+    _ids << reply.id();
+}
+
+void tst_MessageLoader::cleanupTestCase()
+{
+    TestEnvironment::clearStore();
+}
+
+QMailMessageId tst_MessageLoader::addMessage(const QMailAccountId &accountId, const QMailFolderId &folderId,
+                                             const QString &subject, quint64 status,
+                                             QMailMessage::MessageType type)
+{
+    const QMailTimeStamp now(QMailTimeStamp::currentDateTime());
+    QMailMessage message;
+    message.setMessageType(type);
+    message.setParentAccountId(accountId);
+    message.setParentFolderId(folderId);
+    message.setFrom(QMailAddress(QStringLiteral("Sender"), QStringLiteral("Sender@Example.org")));
+    message.setTo(QMailAddress(QStringLiteral("me@example.org")));
+    message.setSubject(subject);
+    message.setRfcId(QStringLiteral("<%1@example.org>").arg(subject.toLower().replace(QLatin1Char(' '), QLatin1Char('.'))));
+    message.setDate(now);
+    message.setReceivedDate(now);
+    message.setStatus(QMailMessage::Incoming | status, true);
+    if (!QMailStore::instance()->addMessage(&message)) {
+        qWarning() << "Cannot add message" << subject;
+    }
+    return message.id();
+}
+
+// Runs a load of all test messages on the worker from this thread
+bool tst_MessageLoader::load(const QString &databasePath, const MessageFilter &filter,
+                             MessageInfoList *messages, CountedMessages *counted)
+{
+    MessageLoaderWorker worker(databasePath);
+    QSignalSpy loaded(&worker, &MessageLoaderWorker::loaded);
+    QList<quint64> ids;
+    for (const QMailMessageId &id : _ids) {
+        ids.append(id.toULongLong());
+    }
+    worker.load(1, ids, filter);
+    if (loaded.isEmpty()) {
+        return false;
+    }
+    *messages = loaded.first().at(1).value<MessageInfoList>();
+    *counted = loaded.first().at(2).value<CountedMessages>();
+    return true;
+}
+
+void tst_MessageLoader::sameAsStore_data()
+{
+    QTest::addColumn<bool>("archive");
+    QTest::addColumn<bool>("countSecond");
+
+    QTest::newRow("inboxes") << false << false;
+    QTest::newRow("inboxes and archive") << true << false;
+    QTest::newRow("counted account") << false << true;
+}
+
+void tst_MessageLoader::sameAsStore()
+{
+    QFETCH(bool, archive);
+    QFETCH(bool, countSecond);
+
+    MessageFilter filter;
+    filter.folderIds << TestEnvironment::inbox(_firstAccount).toULongLong()
+                     << TestEnvironment::inbox(_secondAccount).toULongLong();
+    if (archive) {
+        filter.folderIds << _archive.toULongLong();
+    }
+    filter.excludedStatus = NotifiedStatus;
+    if (countSecond) {
+        filter.countedAccounts << _secondAccount.toULongLong();
+    }
+
+    MessageInfoList messages;
+    CountedMessages counted;
+    QVERIFY(load(MessageLoader::databasePath(), filter, &messages, &counted));
+    std::sort(messages.begin(), messages.end(), idLessThan);
+
+    QMailStore *store = QMailStore::instance();
+    QMailMessageIdList expected(store->queryMessages(QMailMessageKey::id(_ids) & filter.key(),
+                                                     QMailMessageSortKey::id()));
+    QVERIFY(!expected.isEmpty());
+    QCOMPARE(messages.count(), expected.count());
+    for (int i = 0; i < messages.count(); ++i) {
+        const MessageInfo &message(messages.at(i));
+        QCOMPARE(message.id, expected.at(i));
+
+        const QMailMessageMetaData metaData(store->messageMetaData(message.id));
+        QCOMPARE(message.accountId, metaData.parentAccountId());
+        QCOMPARE(message.origin, metaData.from().address().toLower());
+        QCOMPARE(message.sender, metaData.from().name());
+        QCOMPARE(message.subject, metaData.subject());
+        QCOMPARE(message.timeStamp, metaData.date().toUTC());
+        QCOMPARE(message.threadId, metaData.parentThreadId().toULongLong());
+        QCOMPARE(message.rfcId, metaData.rfcId());
+        QCOMPARE(message.hasMultipleRecipients, metaData.recipients().count() > 1);
+    }
+
+    for (quint64 accountId : filter.countedAccounts) {
+        QList<quint64> countedIds(counted.value(accountId));
+        std::sort(countedIds.begin(), countedIds.end());
+        QList<quint64> expectedIds;
+        for (const QMailMessageId &id : store->queryMessages(QMailMessageKey::id(_ids) & filter.countKey(accountId),
+                                                             QMailMessageSortKey::id())) {
+            expectedIds.append(id.toULongLong());
+        }
+        QCOMPARE(countedIds, expectedIds);
+    }
+}
+
+// A database of another QMF version is not queried directly
+void tst_MessageLoader::unknownSchema()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString databasePath(dir.path() + QStringLiteral("/qmailstore.db"));
+    QVERIFY(QFile::copy(MessageLoader::databasePath(), databasePath));
+    // Recent writes can still be in the write-ahead log
+    if (QFile::exists(MessageLoader::databasePath() + QStringLiteral("-wal"))) {
+        QVERIFY(QFile::copy(MessageLoader::databasePath() + QStringLiteral("-wal"),
+                            databasePath + QStringLiteral("-wal")));
+    }
+    {
+        QSqlDatabase database(QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), QStringLiteral("schema")));
+        database.setDatabaseName(databasePath);
+        QVERIFY(database.open());
+        QSqlQuery query(database);
+        QVERIFY(query.exec(QStringLiteral("UPDATE versioninfo SET versionNum = 1000 WHERE tableName = 'mailmessages'")));
+        database.close();
+    }
+    QSqlDatabase::removeDatabase(QStringLiteral("schema"));
+
+    MessageFilter filter;
+    filter.folderIds << TestEnvironment::inbox(_firstAccount).toULongLong();
+    filter.excludedStatus = NotifiedStatus;
+
+    MessageLoaderWorker worker(databasePath);
+    QSignalSpy loaded(&worker, &MessageLoaderWorker::loaded);
+    QSignalSpy failed(&worker, &MessageLoaderWorker::failed);
+    worker.load(1, QList<quint64>() << _ids.first().toULongLong(), filter);
+    QCOMPARE(failed.count(), 1);
+    QVERIFY(loaded.isEmpty());
+}
+
+TEST_ENVIRONMENT_MAIN(tst_MessageLoader)
+
+#include "tst_messageloader.moc"
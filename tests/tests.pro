@@ -0,0 +1,11 @@
+TEMPLATE = subdirs
+
+SUBDIRS = \
+    actionobserver \
+    fakenotificationsd \
+    mailstoreobserver \
+    messageloader
+
+actionobserver.depends = fakenotificationsd
+mailstoreobserver.depends = fakenotificationsd
+messageloader.depends = fakenotificationsd